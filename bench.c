@@ -0,0 +1,314 @@
+// Micro-benchmarks for the server's core functions (make bench && ./bench).
+// server.c is compiled in without its main; every pthread_mutex_lock() and
+// sem_timedwait() inside it is routed through a timing wrapper, so time spent waiting
+// for a lock or for log queue space can be reported, and command_push's retries on a
+// full queue are timed the same way.
+//
+//   ./bench [-n ops] [-p procs] [-j]
+//
+// Each function runs once in a single process and, unless only the scheduler thread
+// may call it, once with procs forked processes sharing one SharedGameData, like
+// the server and its session workers do. Reported per op: wall time, hardware cache misses
+// (perf_event_open; -1 where the kernel does not allow it) and wait. -j prints
+// one JSON object per line instead of the table.
+// log_event waits for queue space, so its ns/op is bounded by how fast the logger
+// thread writes game.log; the report checks every line made it to the file.
+// game.log, which the logger thread writes, goes to a temporary directory.
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+static __thread unsigned long long bench_wait_ns;   // Only the timed thread's own waits
+static int bench_mutex_lock(pthread_mutex_t *m);
+static int bench_sem_timedwait(sem_t *sem, const struct timespec *deadline);
+#define pthread_mutex_lock bench_mutex_lock
+#define sem_timedwait bench_sem_timedwait
+
+#define SERVER_NO_MAIN
+#include "server.c"
+
+#undef pthread_mutex_lock
+#undef sem_timedwait
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Uncontended locks take the trylock fast path and are not timed.
+static int bench_mutex_lock(pthread_mutex_t *m) {
+    if (pthread_mutex_trylock(m) == 0) return 0;
+    unsigned long long start = now_ns();
+    int rc = pthread_mutex_lock(m);
+    bench_wait_ns += now_ns() - start;
+    return rc;
+}
+
+// Likewise: log_event only waits here when the log queue is full.
+static int bench_sem_timedwait(sem_t *sem, const struct timespec *deadline) {
+    if (sem_trywait(sem) == 0) return 0;
+    unsigned long long start = now_ns();
+    int rc = sem_timedwait(sem, deadline);
+    bench_wait_ns += now_ns() - start;
+    return rc;
+}
+
+typedef struct {
+    const char *name;
+    void (*setup)(SharedGameData *data);
+    void (*op)(SharedGameData *data, long i);
+    bool writer_only;
+} Benchmark;
+
+typedef struct {
+    unsigned long long elapsed_ns;
+    unsigned long long wait_ns;
+} WorkerResult;
+
+static bool json_output = false;
+static FILE *report_out;           // stdout itself is silenced: the scheduler and logger threads print as they run
+
+// --- Operations ---
+static void setup_players(SharedGameData *data) {
+    Room *room = &data->rooms[0];
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (room->players[i].state != PLAYER_DISCONNECTED) continue;
+        char name[MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "bench%d", i + 1);
+        add_player(room, name, (unsigned int)i + 1);
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) room->players[i].position = (i * 17) % BOARD_SIZE;
+    start_game(room, 42);
+    publish_view(room);
+}
+
+static void setup_scores(SharedGameData *data) {
+    setup_players(data);
+    scores_clear(&g_scores);
+}
+
+static volatile int sink;
+
+static void op_check_snake_ladder(SharedGameData *data, long i) {
+    sink += check_snake_ladder((int)(i % BOARD_SIZE) + 1);
+}
+
+static void op_read_view(SharedGameData *data, long i) {
+    GameView view;
+    read_view(&data->rooms[0], &view);
+    sink += view.position[i % MAX_PLAYERS];
+}
+
+static void op_generate_board_string(SharedGameData *data, long i) {
+    GameView view;
+    char board[BOARD_STR_LEN];
+    read_view(&data->rooms[0], &view);
+    generate_board_string(&view, board, sizeof(board));
+    sink += board[i % 64];
+}
+
+static void op_log_event(SharedGameData *data, long i) {
+    log_event(data, "MOVE: T1 P1 bench rolled 3 from 10 to 13");
+}
+
+// A roll for a turn that never comes: the scheduler pops it and drops it. Retries
+// while the queue is full count as wait.
+static void op_command_push(SharedGameData *data, long i) {
+    Command cmd = { .type = CMD_ROLL, .player = (int)(i % MAX_PLAYERS), .turn = -1, .token = 1 };
+    if (command_push(data, &cmd, NULL)) return;
+    unsigned long long start = now_ns();
+    while (!command_push(data, &cmd, NULL)) sched_yield();
+    bench_wait_ns += now_ns() - start;
+}
+
+static void op_process_score_update(SharedGameData *data, long i) {
+    data->rooms[0].winner_index = (int)(i % MAX_PLAYERS);
+    data->rooms[0].scores_updated_for_game = false;
+    process_score_update(&g_scores, &data->rooms[0]);
+}
+
+static void op_get_next_active_player(SharedGameData *data, long i) {
+    sink += get_next_active_player(&data->rooms[0], (int)(i % MAX_PLAYERS));
+}
+
+static void op_play_turn(SharedGameData *data, long i) {
+    Room *room = &data->rooms[0];
+    if (play_turn(room).to == BOARD_SIZE) {
+        for (int p = 0; p < MAX_PLAYERS; p++) room->players[p].position = 0;
+        start_game(room, (unsigned int)i);
+    }
+}
+
+// Scheduler-only functions are timed in one process: the room has a single writer.
+static const Benchmark benchmarks[] = {
+    { "check_snake_ladder",     setup_players, op_check_snake_ladder,     false },
+    { "read_view",              setup_players, op_read_view,              false },
+    { "generate_board_string",  setup_players, op_generate_board_string,  false },
+    { "log_event+logger_thread", setup_players, op_log_event,             false },
+    { "command_push+scheduler", setup_players, op_command_push,           false },
+    { "process_score_update",   setup_scores,  op_process_score_update,   true },
+    { "get_next_active_player", setup_players, op_get_next_active_player, false },
+    { "play_turn",              setup_players, op_play_turn,              true },
+};
+
+// --- Measurement ---
+static int open_cache_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;              // Count the forked workers as well
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long read_counter(int fd) {
+    long long value;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return -1;
+    return value;
+}
+
+static void run_ops(const Benchmark *b, SharedGameData *data, long ops, WorkerResult *out) {
+    bench_wait_ns = 0;
+    unsigned long long start = now_ns();
+    for (long i = 0; i < ops; i++) b->op(data, i);
+    out->elapsed_ns = now_ns() - start;
+    out->wait_ns = bench_wait_ns;
+}
+
+// Returns the number of log lines the logger wrote, or -1 when no logger was running.
+static long stop_logger(SharedGameData *data, pthread_t t_log) {
+    while (data->log_head != data->log_tail) usleep(1000);
+    g_logger_running = false;
+    sem_post(&data->log_sem);
+    pthread_join(t_log, NULL);
+    g_logger_running = true;
+
+    long lines = 0;
+    char line[LOG_MSG_LEN + 64];
+    FILE *f = fopen("game.log", "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) lines++;
+        fclose(f);
+    }
+    unlink("game.log");
+    return lines;
+}
+
+static void report(const Benchmark *b, int procs, long ops, WorkerResult *results,
+                   long long cache_misses, long logged) {
+    unsigned long long elapsed = 0, wait = 0;
+    for (int p = 0; p < procs; p++) {
+        if (results[p].elapsed_ns > elapsed) elapsed = results[p].elapsed_ns;
+        wait += results[p].wait_ns;
+    }
+    long total_ops = ops * procs;
+    double ns_per_op = (double)elapsed / ops;    // Per process: time for one op under this contention
+    double misses = cache_misses >= 0 ? (double)cache_misses / total_ops : -1;
+    double wait_per_op = (double)wait / total_ops;
+
+    if (json_output) {
+        fprintf(report_out, "{\"bench\":\"%s\",\"procs\":%d,\"ops\":%ld,\"ns_per_op\":%.1f,"
+               "\"cache_misses_per_op\":%.3f,\"wait_ns_per_op\":%.1f,\"log_lines\":%ld}\n",
+               b->name, procs, total_ops, ns_per_op, misses, wait_per_op, logged);
+    } else {
+        fprintf(report_out, "%-24s %5d %10ld %12.1f %12.3f %14.1f", b->name, procs, total_ops, ns_per_op, misses, wait_per_op);
+        if (logged >= 0) fprintf(report_out, "   (%ld of %ld lines in game.log)", logged, total_ops);
+        fprintf(report_out, "\n");
+    }
+    fflush(report_out);
+}
+
+static void run_benchmark(const Benchmark *b, SharedGameData *data, int procs, long ops,
+                          WorkerResult *results) {
+    initialize_sync_primitives(data);
+    b->setup(data);
+
+    bool uses_logger = (b->op == op_log_event);
+    bool uses_scheduler = (b->op == op_command_push);
+    pthread_t t_log, t_sched;
+    if (uses_logger) pthread_create(&t_log, NULL, logger_thread, data);
+    if (uses_scheduler) pthread_create(&t_sched, NULL, scheduler_thread, data);
+
+    int counter = open_cache_counter();
+    if (counter >= 0) { ioctl(counter, PERF_EVENT_IOC_RESET, 0); ioctl(counter, PERF_EVENT_IOC_ENABLE, 0); }
+
+    if (procs == 1) {
+        run_ops(b, data, ops, &results[0]);
+    } else {
+        for (int p = 0; p < procs; p++) {
+            if (fork() == 0) {
+                run_ops(b, data, ops, &results[p]);
+                _exit(0);
+            }
+        }
+        for (int p = 0; p < procs; p++) wait(NULL);
+    }
+
+    if (uses_scheduler) {
+        // Timed up to the last push; the scheduler then drains what is left.
+        g_threads_running = false;
+        sem_post(&data->cmd_sem);
+        pthread_join(t_sched, NULL);
+        g_threads_running = true;
+    }
+    if (counter >= 0) ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+    long long misses = read_counter(counter);
+    if (counter >= 0) close(counter);
+    long logged = uses_logger ? stop_logger(data, t_log) : -1;
+
+    report(b, procs, ops, results, misses, logged);
+    cleanup_sync_primitives(data);
+}
+
+int main(int argc, char *argv[]) {
+    long ops = 200000;
+    int procs = 4;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:j")) != -1) {
+        switch (opt) {
+            case 'n': ops = atol(optarg); break;
+            case 'p': procs = atoi(optarg); break;
+            case 'j': json_output = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n ops] [-p procs] [-j]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (ops < 1 || procs < 1) { fprintf(stderr, "ops and procs must be positive\n"); return 1; }
+
+    char dir[] = "/tmp/snl_bench_XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) == -1) { perror("[BENCH] Temp dir"); return 1; }
+    init_game_board();
+    report_out = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report_out || !freopen("/dev/null", "w", stdout)) return 1;
+
+    // Shared like the server's segment, so forked workers contend on the same locks.
+    SharedGameData *data = mmap(NULL, sizeof(SharedGameData), PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    WorkerResult *results = mmap(NULL, sizeof(WorkerResult) * procs, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED || results == MAP_FAILED) { perror("[BENCH] mmap"); return 1; }
+
+    if (!json_output)
+        fprintf(report_out, "%-24s %5s %10s %12s %12s %14s\n", "benchmark", "procs", "ops", "ns/op", "misses/op", "wait_ns/op");
+
+    int n = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    for (int i = 0; i < n; i++) {
+        run_benchmark(&benchmarks[i], data, 1, ops, results);
+        if (procs > 1 && !benchmarks[i].writer_only) run_benchmark(&benchmarks[i], data, procs, ops, results);
+    }
+
+    unlink("game.log");
+    if (chdir("/") == 0) rmdir(dir);
+    return 0;
+}
@@ -8,8 +8,13 @@
 #define PORT 8080
 #define BUFFER_SIZE 4096 
 
-int main() {
+// ./client       interactive: press Enter to roll
+// ./client -a    auto-play: rolls without waiting for input and sends the next ROLL
+//                as soon as its own move is done, so the server applies it the
+//                instant the turn comes back around
+int main(int argc, char *argv[]) {
     int sock = 0, valread;
+    int auto_play = (argc > 1 && strcmp(argv[1], "-a") == 0);
     struct sockaddr_in serv_addr;
     char buffer[BUFFER_SIZE] = {0};
     char input[100];
@@ -34,8 +39,8 @@ int main() {
         
         if (strncmp(buffer, "YOUR_TURN|", 10) == 0) {
             printf("\n%s", buffer + 10); 
-            fgets(input, sizeof(input), stdin);
-            send(sock, "ROLL", 4, 0);
+            if (!auto_play) fgets(input, sizeof(input), stdin);
+            send(sock, "ROLL\n", 5, 0);
         } 
         
         else if (strncmp(buffer, "RESULT|", 7) == 0) {
@@ -50,6 +55,9 @@ int main() {
                 printf("%s", game_over_ptr + 10);
                 printf("\n********************************\n");
             }
+            else if (auto_play && strncmp(buffer + 7, "Rolled", 6) == 0) {
+                send(sock, "ROLL\n", 5, 0);
+            }
         }
      
         else if (strncmp(buffer, "GAME_OVER|", 10) == 0) {
@@ -0,0 +1,663 @@
+// Columnar index over game.log for offline analytics.
+// Each run parses only the log bytes added since the last run and appends them as new
+// segment files; existing segments are never rewritten.
+//
+//   ./logindex [-l game.log] [-d game.idx]                 build / update the index
+//   ./logindex -q games|snakes|win-rate [-d dir] [-s from] [-u until]
+//                                                          query (times are epoch seconds)
+//   ./logindex -G rows [-d dir]                            append synthetic moves for benchmarking
+//
+// Segment file (seg-NNNNNN.col): SegmentHeader, then one array per column:
+//   time u32[rows] | game u32[rows] | player u16[rows] | type u8 | roll u8 | from u8 | to u8
+// A segment covers at most SEG_ROWS events and never spans two days, and its header
+// carries the time and game ranges so queries can skip it without touching the data.
+// Rooms play at the same time; each log line is followed in the room its R<room>
+// tag names (untagged lines: room 0), and every game gets an index-wide id.
+// server.c is compiled in without its main for the board, the player limits and the
+// turn rules the synthetic games are played with.
+
+#define _GNU_SOURCE                    // strptime
+#define SERVER_NO_MAIN
+#include "server.c"
+
+#include <stdint.h>
+
+#define SEG_ROWS (1 << 20)
+#define SEG_MAGIC 0x58494c53u          // "SLIX"
+#define NO_PLAYER 0xFFFF
+#define LINE_LEN 512
+#define STATE_MAGIC 0x31545353u        // "SST1"
+
+typedef enum {
+    EV_MOVE = 0,
+    EV_TIMEOUT,
+    EV_JOIN,
+    EV_LEAVE,
+    EV_GAME_START,
+    EV_GAME_OVER,
+    EV_RESET,
+    EV_SERVER_START
+} EventType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t rows;
+    uint32_t t_min, t_max;
+    uint32_t game_min, game_max;
+    uint32_t reserved[2];
+} SegmentHeader;
+
+// Parser position, saved between runs so updates continue where the last one stopped.
+// state.bin holds an IndexState followed by room_count RoomIndexStates.
+typedef struct {
+    uint32_t magic;
+    uint32_t room_count;
+    uint64_t offset;                 // Bytes of the log already indexed
+    uint32_t next_segment;
+    uint32_t game;                   // Games seen so far (the server's game= restarts at 0)
+    int32_t pos_player[16];          // Positions for legacy MOVE lines, which have no "from"
+    int32_t pos_value[16];
+} IndexState;
+
+typedef struct {
+    uint32_t game;                   // Index-wide id of the room's current or last game
+    int32_t slot_player[MAX_PLAYERS];
+    int32_t last_mover, last_to;
+} RoomIndexState;
+
+static RoomIndexState *room_states;
+
+typedef struct {
+    uint32_t rows, cap;
+    uint32_t *time, *game;
+    uint16_t *player;
+    uint8_t *type, *roll, *from, *to;
+} ColumnBuffer;
+
+static const char *idx_dir = "game.idx";
+
+// --- Player Dictionary (players.txt, id = line number) ---
+typedef struct {
+    char (*names)[MAX_NAME_LEN];
+    uint32_t count, cap;
+    int32_t *slots;                  // Open-addressing hash of name -> id
+    uint32_t slot_cap;
+    FILE *out;                       // New names are appended as they are seen
+} PlayerDict;
+
+static PlayerDict dict;
+
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) { h ^= (uint8_t)*s++; h *= 16777619u; }
+    return h;
+}
+
+static void dict_insert_slot(uint32_t id) {
+    uint32_t i = hash_name(dict.names[id]) & (dict.slot_cap - 1);
+    while (dict.slots[i] != -1) i = (i + 1) & (dict.slot_cap - 1);
+    dict.slots[i] = id;
+}
+
+static void dict_grow(void) {
+    dict.cap = dict.cap ? dict.cap * 2 : 256;
+    dict.names = realloc(dict.names, dict.cap * sizeof(*dict.names));
+    dict.slot_cap = dict.cap * 2;
+    free(dict.slots);
+    dict.slots = malloc(dict.slot_cap * sizeof(int32_t));
+    memset(dict.slots, -1, dict.slot_cap * sizeof(int32_t));
+    for (uint32_t i = 0; i < dict.count; i++) dict_insert_slot(i);
+}
+
+static int dict_lookup(const char *name, bool add) {
+    if (dict.slot_cap) {
+        uint32_t i = hash_name(name) & (dict.slot_cap - 1);
+        while (dict.slots[i] != -1) {
+            if (strcmp(dict.names[dict.slots[i]], name) == 0) return dict.slots[i];
+            i = (i + 1) & (dict.slot_cap - 1);
+        }
+    }
+    if (!add || dict.count >= NO_PLAYER) return NO_PLAYER;
+    if (dict.count == dict.cap) dict_grow();
+    strncpy(dict.names[dict.count], name, MAX_NAME_LEN - 1);
+    dict.names[dict.count][MAX_NAME_LEN - 1] = '\0';
+    dict_insert_slot(dict.count);
+    if (dict.out) fprintf(dict.out, "%s\n", dict.names[dict.count]);
+    return dict.count++;
+}
+
+static void dict_load(bool for_append) {
+    char path[256], line[LINE_LEN];
+    snprintf(path, sizeof(path), "%s/players.txt", idx_dir);
+    FILE *f = fopen(path, "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\n")] = '\0';
+            dict_lookup(line, true);
+        }
+        fclose(f);
+    }
+    if (for_append) dict.out = fopen(path, "a");
+}
+
+// --- Index Builder ---
+static void columns_init(ColumnBuffer *c) {
+    c->rows = 0;
+    c->cap = SEG_ROWS;
+    c->time = malloc(c->cap * sizeof(uint32_t));
+    c->game = malloc(c->cap * sizeof(uint32_t));
+    c->player = malloc(c->cap * sizeof(uint16_t));
+    c->type = malloc(c->cap);
+    c->roll = malloc(c->cap);
+    c->from = malloc(c->cap);
+    c->to = malloc(c->cap);
+}
+
+static int columns_flush(ColumnBuffer *c, IndexState *st) {
+    if (c->rows == 0) return 0;
+    SegmentHeader h = { .magic = SEG_MAGIC, .rows = c->rows,
+                        .t_min = UINT32_MAX, .game_min = UINT32_MAX };
+    for (uint32_t i = 0; i < c->rows; i++) {
+        if (c->time[i] < h.t_min) h.t_min = c->time[i];
+        if (c->time[i] > h.t_max) h.t_max = c->time[i];
+        if (c->game[i] < h.game_min) h.game_min = c->game[i];
+        if (c->game[i] > h.game_max) h.game_max = c->game[i];
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/seg-%06u.col", idx_dir, st->next_segment);
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror("[INDEX] Failed to write segment"); return -1; }
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(c->time, sizeof(uint32_t), c->rows, f);
+    fwrite(c->game, sizeof(uint32_t), c->rows, f);
+    fwrite(c->player, sizeof(uint16_t), c->rows, f);
+    fwrite(c->type, 1, c->rows, f);
+    fwrite(c->roll, 1, c->rows, f);
+    fwrite(c->from, 1, c->rows, f);
+    fwrite(c->to, 1, c->rows, f);
+    if (fclose(f) != 0) { perror("[INDEX] Failed to write segment"); return -1; }
+
+    st->next_segment++;
+    c->rows = 0;
+    return 0;
+}
+
+static int columns_append(ColumnBuffer *c, IndexState *st, uint32_t t, uint32_t game, EventType type,
+                          int player, int roll, int from, int to) {
+    // Segments never span a day so time-filtered queries can skip whole files.
+    if (c->rows == c->cap || (c->rows > 0 && t / 86400 != c->time[c->rows - 1] / 86400)) {
+        if (columns_flush(c, st) == -1) return -1;
+    }
+    uint32_t i = c->rows++;
+    c->time[i] = t;
+    c->game[i] = game;
+    c->player[i] = (uint16_t)player;
+    c->type[i] = (uint8_t)type;
+    c->roll[i] = (uint8_t)roll;
+    c->from[i] = (uint8_t)from;
+    c->to[i] = (uint8_t)to;
+    return 0;
+}
+
+static void reset_positions(IndexState *st, RoomIndexState *rs) {
+    for (int i = 0; i < 16; i++) st->pos_player[i] = -1;
+    rs->last_mover = -1;
+    rs->last_to = 0;
+}
+
+static void room_state_init(RoomIndexState *rs, uint32_t game) {
+    rs->game = game;
+    for (int i = 0; i < MAX_PLAYERS; i++) rs->slot_player[i] = NO_PLAYER;
+    rs->last_mover = -1;
+    rs->last_to = 0;
+}
+
+// Rooms are added as the log first mentions them.
+static RoomIndexState *room_state(IndexState *st, int room) {
+    if ((uint32_t)room >= st->room_count) {
+        RoomIndexState *rooms = realloc(room_states, sizeof(RoomIndexState) * (room + 1));
+        if (!rooms) return NULL;
+        for (int r = st->room_count; r <= room; r++) room_state_init(&rooms[r], st->game);
+        room_states = rooms;
+        st->room_count = room + 1;
+    }
+    return &room_states[room];
+}
+
+static int32_t *position_of(IndexState *st, int player) {
+    for (int i = 0; i < 16; i++) if (st->pos_player[i] == player) return &st->pos_value[i];
+    for (int i = 0; i < 16; i++) if (st->pos_player[i] == -1) {
+        st->pos_player[i] = player;
+        st->pos_value[i] = 0;
+        return &st->pos_value[i];
+    }
+    return NULL;
+}
+
+// "[Sun Oct 18 18:39:38 2026] ..." -> epoch seconds. Consecutive lines usually share
+// the timestamp, so the last conversion is cached.
+static uint32_t parse_time(const char *line) {
+    static char last[32];
+    static uint32_t last_t;
+    const char *end = strchr(line, ']');
+    if (line[0] != '[' || !end || end - line - 1 >= (int)sizeof(last)) return 0;
+    int len = (int)(end - line - 1);
+    if (strncmp(last, line + 1, len) == 0 && last[len] == '\0') return last_t;
+
+    struct tm tm = {0};
+    char stamp[32];
+    memcpy(stamp, line + 1, len);
+    stamp[len] = '\0';
+    if (!strptime(stamp, "%a %b %d %H:%M:%S %Y", &tm)) return 0;
+    tm.tm_isdst = -1;
+    memcpy(last, stamp, len + 1);
+    last_t = (uint32_t)mktime(&tm);
+    return last_t;
+}
+
+static int index_line(ColumnBuffer *c, IndexState *st, const char *line) {
+    uint32_t t = parse_time(line);
+    const char *msg = strstr(line, "] ");
+    if (!msg) return 0;
+    int room;
+    msg = log_message_room(msg + 2, &room);
+    RoomIndexState *rs = room_state(st, room);
+    if (!rs) return -1;
+
+    int turn, slot, roll, from, to;
+    char name[MAX_NAME_LEN];
+
+    if (strncmp(msg, "MOVE: ", 6) == 0) {
+        // New format: "MOVE: T3 P1 name rolled 4 from 10 to 14"; legacy: "MOVE: name rolled 4 to 14"
+        const char *name_start = msg + 6;
+        bool has_from = sscanf(msg, "MOVE: T%d P%d ", &turn, &slot) == 2;
+        if (has_from) name_start = strchr(strchr(name_start, ' ') + 1, ' ') + 1;
+        const char *rolled = strstr(name_start, " rolled ");
+        if (!rolled) return 0;
+        int len = (int)(rolled - name_start);
+        if (len >= MAX_NAME_LEN) len = MAX_NAME_LEN - 1;
+        memcpy(name, name_start, len);
+        name[len] = '\0';
+        int player = dict_lookup(name, true);
+        int32_t *pos = position_of(st, player);
+
+        if (has_from) {
+            if (sscanf(rolled, " rolled %d from %d to %d", &roll, &from, &to) != 3) return 0;
+        } else {
+            if (sscanf(rolled, " rolled %d to %d", &roll, &to) != 2) return 0;
+            from = pos ? *pos : 0;
+        }
+        if (pos) *pos = to;
+        rs->last_mover = player;
+        rs->last_to = to;
+        return columns_append(c, st, t, rs->game, EV_MOVE, player, roll, from, to);
+    }
+    if (strncmp(msg, "TIMEOUT:", 8) == 0) {
+        int player = NO_PLAYER;
+        if (sscanf(msg, "TIMEOUT: T%d P%d", &turn, &slot) == 2 && slot >= 1 && slot <= MAX_PLAYERS)
+            player = rs->slot_player[slot - 1];
+        return columns_append(c, st, t, rs->game, EV_TIMEOUT, player, 0, 0, 0);
+    }
+    if (strncmp(msg, "PLAYER_JOIN: ", 13) == 0) {
+        const char *end = strstr(msg, " connected");
+        if (!end) return 0;
+        int len = (int)(end - (msg + 13));
+        if (len >= MAX_NAME_LEN) len = MAX_NAME_LEN - 1;
+        memcpy(name, msg + 13, len);
+        name[len] = '\0';
+        int player = dict_lookup(name, true);
+        if (sscanf(end, " connected as P%d", &slot) == 1 && slot >= 1 && slot <= MAX_PLAYERS)
+            rs->slot_player[slot - 1] = player;
+        return columns_append(c, st, t, rs->game, EV_JOIN, player, 0, 0, 0);
+    }
+    if (sscanf(msg, "PLAYER_LEAVE: P%d", &slot) == 1) {
+        int player = (slot >= 1 && slot <= MAX_PLAYERS) ? rs->slot_player[slot - 1] : NO_PLAYER;
+        return columns_append(c, st, t, rs->game, EV_LEAVE, player, 0, 0, 0);
+    }
+    if (strncmp(msg, "GAME_START:", 11) == 0) {
+        rs->game = st->game++;
+        reset_positions(st, rs);
+        return columns_append(c, st, t, rs->game, EV_GAME_START, NO_PLAYER, 0, 0, 0);
+    }
+    if (strncmp(msg, "GAME_OVER:", 10) == 0) {
+        int winner = rs->last_to == BOARD_SIZE ? rs->last_mover : NO_PLAYER;
+        return columns_append(c, st, t, rs->game, EV_GAME_OVER, winner, 0, 0, 0);
+    }
+    if (strncmp(msg, "GAME_RESET:", 11) == 0) {
+        reset_positions(st, rs);
+        return columns_append(c, st, t, rs->game, EV_RESET, NO_PLAYER, 0, 0, 0);
+    }
+    if (strncmp(msg, "SERVER_START:", 13) == 0) {
+        for (uint32_t r = 0; r < st->room_count; r++) room_state_init(&room_states[r], st->game);
+        reset_positions(st, rs);
+        return columns_append(c, st, t, st->game, EV_SERVER_START, NO_PLAYER, 0, 0, 0);
+    }
+    return 0;
+}
+
+static void state_path(char *path, size_t size) {
+    snprintf(path, size, "%s/state.bin", idx_dir);
+}
+
+// Returns -1 if state.bin exists but was written by an older logindex.
+static int state_load(IndexState *st) {
+    char path[256];
+    state_path(path, sizeof(path));
+    memset(st, 0, sizeof(*st));
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        uint32_t rooms = 0;
+        bool ok = fread(st, sizeof(*st), 1, f) == 1 && st->magic == STATE_MAGIC;
+        if (ok) {
+            rooms = st->room_count;
+            st->room_count = 0;
+            ok = rooms == 0 || (rooms <= MAX_ROOMS && room_state(st, (int)rooms - 1) != NULL);
+        }
+        ok = ok && fread(room_states, sizeof(RoomIndexState), rooms, f) == rooms;
+        fclose(f);
+        if (!ok) {
+            fprintf(stderr, "[INDEX] %s is unreadable or from an older version; remove %s to rebuild.\n", path, idx_dir);
+            return -1;
+        }
+        return 0;
+    }
+    st->magic = STATE_MAGIC;
+    for (int i = 0; i < 16; i++) st->pos_player[i] = -1;
+    return 0;
+}
+
+static int state_save(IndexState *st) {
+    char path[256], tmp[260];
+    state_path(path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f || fwrite(st, sizeof(*st), 1, f) != 1 ||
+        fwrite(room_states, sizeof(RoomIndexState), st->room_count, f) != st->room_count || fclose(f) != 0) {
+        perror("[INDEX] Failed to save state");
+        return -1;
+    }
+    return rename(tmp, path);
+}
+
+static int build_index(const char *log_path) {
+    mkdir(idx_dir, 0755);
+    IndexState st;
+    if (state_load(&st) == -1) return 1;
+
+    FILE *log = fopen(log_path, "r");
+    if (!log) { perror("[INDEX] Failed to open log"); return 1; }
+    struct stat sb;
+    fstat(fileno(log), &sb);
+    if ((uint64_t)sb.st_size < st.offset) {
+        fprintf(stderr, "[INDEX] %s is shorter than the indexed part; remove %s to rebuild.\n", log_path, idx_dir);
+        fclose(log);
+        return 1;
+    }
+    fseek(log, (long)st.offset, SEEK_SET);
+    dict_load(true);
+
+    ColumnBuffer c;
+    columns_init(&c);
+    char line[LINE_LEN];
+    uint64_t offset = st.offset;
+    long lines = 0;
+    while (fgets(line, sizeof(line), log)) {
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n') break;   // Logger is mid-write; pick it up next run
+        if (index_line(&c, &st, line) == -1) { fclose(log); return 1; }
+        offset += len;
+        lines++;
+    }
+    fclose(log);
+
+    if (columns_flush(&c, &st) == -1) return 1;
+    if (dict.out) fclose(dict.out);
+    st.offset = offset;
+    if (state_save(&st) == -1) return 1;
+    printf("[INDEX] %ld new lines indexed, %u segments, %u players, %u games.\n",
+           lines, st.next_segment, dict.count, st.game);
+    return 0;
+}
+
+// Appends rows move events of synthetic 4-player games, to measure query speed at scale.
+// The games are played on the server's board with its turn rules (play_turn).
+static int generate_synthetic(long rows) {
+    mkdir(idx_dir, 0755);
+    IndexState st;
+    if (state_load(&st) == -1) return 1;
+    dict_load(true);
+
+    Room *room = malloc(sizeof(Room));
+    if (!room) return 1;
+    init_game_board();
+    room_init(room);
+    int ids[4];
+    for (int i = 0; i < 4; i++) {
+        char name[MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "bot%d", i + 1);
+        ids[add_player(room, name, 0)] = dict_lookup(name, true);
+    }
+    unsigned int seed = 2463534242u;
+    start_game(room, seed);
+
+    ColumnBuffer c;
+    columns_init(&c);
+    uint32_t t = (uint32_t)time(NULL);
+    for (long r = 0; r < rows; r++) {
+        TurnResult m = play_turn(room);
+        if (columns_append(&c, &st, t, st.game, EV_MOVE, ids[m.player], m.roll, m.from, m.to) == -1) return 1;
+        if (m.to == BOARD_SIZE) {
+            columns_append(&c, &st, t, st.game, EV_GAME_OVER, ids[m.player], 0, 0, 0);
+            for (int i = 0; i < 4; i++) room->players[i].position = 0;
+            start_game(room, ++seed);
+            st.game++;
+            t++;
+        }
+    }
+    free(room);
+    if (columns_flush(&c, &st) == -1) return 1;
+    if (dict.out) fclose(dict.out);
+    if (state_save(&st) == -1) return 1;
+    printf("[INDEX] %ld synthetic moves appended, %u segments.\n", rows, st.next_segment);
+    return 0;
+}
+
+// --- Queries ---
+typedef struct {
+    uint32_t rows;
+    const uint32_t *time, *game;
+    const uint16_t *player;
+    const uint8_t *type, *roll, *from, *to;
+} Segment;
+
+typedef struct {
+    uint32_t since, until;
+    // games
+    uint32_t game_base, game_span;
+    uint32_t *game_moves, *game_first, *game_last;
+    uint8_t *game_done;
+    // snakes
+    uint64_t snake_hits[BOARD_SIZE + 1];
+    uint64_t moves;
+    // win-rate
+    uint64_t *wins, *played;
+    uint32_t *last_game;
+} QueryAcc;
+
+static void scan_games(QueryAcc *q, const Segment *s, uint32_t lo, uint32_t hi) {
+    for (uint32_t i = lo; i < hi; i++) {
+        uint32_t g = s->game[i] - q->game_base;
+        if (s->type[i] == EV_MOVE) {
+            q->game_moves[g]++;
+            if (!q->game_first[g]) q->game_first[g] = s->time[i];
+        } else if (s->type[i] == EV_GAME_OVER) {
+            q->game_done[g] = 1;
+            q->game_last[g] = s->time[i];
+        }
+    }
+}
+
+// Branch-free over the hot columns: every row adds 0 or 1.
+static void scan_snakes(QueryAcc *q, const Segment *s, uint32_t lo, uint32_t hi) {
+    for (uint32_t i = lo; i < hi; i++) {
+        uint32_t cell = (uint32_t)s->from[i] + s->roll[i];
+        uint32_t is_move = s->type[i] == EV_MOVE;
+        uint32_t valid = is_move & (cell <= BOARD_SIZE);
+        cell = valid ? cell : 0;
+        q->moves += is_move;
+        q->snake_hits[cell] += valid & (s->to[i] < cell);
+    }
+}
+
+static void scan_win_rate(QueryAcc *q, const Segment *s, uint32_t lo, uint32_t hi) {
+    for (uint32_t i = lo; i < hi; i++) {
+        uint16_t p = s->player[i];
+        if (p == NO_PLAYER || p >= dict.count) continue;
+        if (s->type[i] == EV_MOVE && q->last_game[p] != s->game[i] + 1) {
+            q->last_game[p] = s->game[i] + 1;
+            q->played[p]++;
+        } else if (s->type[i] == EV_GAME_OVER) {
+            q->wins[p]++;
+        }
+    }
+}
+
+static int run_query(const char *query, uint32_t since, uint32_t until) {
+    IndexState st;
+    if (state_load(&st) == -1) return 1;
+    dict_load(false);
+    if (st.next_segment == 0) { fprintf(stderr, "[QUERY] No index in %s; run ./logindex first.\n", idx_dir); return 1; }
+
+    int kind = strcmp(query, "games") == 0 ? 0 : strcmp(query, "snakes") == 0 ? 1 :
+               strcmp(query, "win-rate") == 0 ? 2 : -1;
+    if (kind < 0) { fprintf(stderr, "[QUERY] Unknown query '%s' (games, snakes, win-rate)\n", query); return 1; }
+
+    QueryAcc *q = calloc(1, sizeof(QueryAcc));
+    q->since = since;
+    q->until = until;
+    q->game_span = st.game + 1;
+    if (kind == 0) {
+        q->game_moves = calloc(q->game_span, sizeof(uint32_t));
+        q->game_first = calloc(q->game_span, sizeof(uint32_t));
+        q->game_last = calloc(q->game_span, sizeof(uint32_t));
+        q->game_done = calloc(q->game_span, 1);
+    } else if (kind == 2) {
+        q->wins = calloc(dict.count + 1, sizeof(uint64_t));
+        q->played = calloc(dict.count + 1, sizeof(uint64_t));
+        q->last_game = calloc(dict.count + 1, sizeof(uint32_t));
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t scanned = 0;
+    uint32_t skipped = 0;
+
+    for (uint32_t n = 0; n < st.next_segment; n++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/seg-%06u.col", idx_dir, n);
+        int fd = open(path, O_RDONLY);
+        if (fd == -1) continue;
+        struct stat sb;
+        fstat(fd, &sb);
+        SegmentHeader h;
+        if (sb.st_size < (off_t)sizeof(h) || pread(fd, &h, sizeof(h), 0) != sizeof(h) || h.magic != SEG_MAGIC) {
+            close(fd);
+            continue;
+        }
+        if (h.t_max < since || h.t_min > until) { skipped++; close(fd); continue; }
+
+        void *map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) continue;
+        posix_madvise(map, sb.st_size, POSIX_MADV_SEQUENTIAL);
+
+        const char *base = (const char*)map + sizeof(SegmentHeader);
+        Segment s = { .rows = h.rows };
+        s.time = (const uint32_t*)base;
+        s.game = s.time + h.rows;
+        s.player = (const uint16_t*)(s.game + h.rows);
+        s.type = (const uint8_t*)(s.player + h.rows);
+        s.roll = s.type + h.rows;
+        s.from = s.roll + h.rows;
+        s.to = s.from + h.rows;
+
+        // Segments entirely inside the window are scanned without a per-row time test;
+        // a boundary segment is narrowed to the matching run (rows are in time order).
+        uint32_t lo = 0, hi = h.rows;
+        if (h.t_min < since) while (lo < hi && s.time[lo] < since) lo++;
+        if (h.t_max > until) while (hi > lo && s.time[hi - 1] > until) hi--;
+
+        if (kind == 0) scan_games(q, &s, lo, hi);
+        else if (kind == 1) scan_snakes(q, &s, lo, hi);
+        else scan_win_rate(q, &s, lo, hi);
+        scanned += hi - lo;
+        munmap(map, sb.st_size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    if (kind == 0) {
+        uint64_t games = 0, moves = 0, seconds = 0;
+        for (uint32_t g = 0; g < q->game_span; g++) {
+            if (!q->game_done[g]) continue;
+            games++;
+            moves += q->game_moves[g];
+            if (q->game_first[g]) seconds += q->game_last[g] - q->game_first[g];
+        }
+        printf("Finished games: %lu\n", (unsigned long)games);
+        if (games) printf("Average length: %.1f moves, %.1f seconds\n", (double)moves / games, (double)seconds / games);
+    } else if (kind == 1) {
+        // Every landing on a snake's head slides, so a cell's share is taken of all
+        // slides and of all moves rather than of its own landings.
+        uint64_t slides = 0;
+        for (int cell = 1; cell <= BOARD_SIZE; cell++) slides += q->snake_hits[cell];
+        printf("%-6s %-10s %-10s %s\n", "Cell", "Snakes", "Of slides", "Of moves");
+        for (int shown = 0; shown < 10; shown++) {
+            int best = 0;
+            for (int cell = 1; cell <= BOARD_SIZE; cell++)
+                if (q->snake_hits[cell] > q->snake_hits[best]) best = cell;
+            if (!q->snake_hits[best]) break;
+            char of_slides[16];
+            snprintf(of_slides, sizeof(of_slides), "%.1f%%", 100.0 * q->snake_hits[best] / slides);
+            printf("%-6d %-10lu %-10s %.2f%%\n", best, (unsigned long)q->snake_hits[best], of_slides,
+                   100.0 * q->snake_hits[best] / q->moves);
+            q->snake_hits[best] = 0;
+        }
+    } else {
+        printf("%-*s %-8s %-8s %s\n", MAX_NAME_LEN, "Player", "Wins", "Games", "Win rate");
+        for (uint32_t p = 0; p < dict.count; p++) {
+            if (!q->played[p]) continue;
+            printf("%-*s %-8lu %-8lu %.1f%%\n", MAX_NAME_LEN, dict.names[p], (unsigned long)q->wins[p],
+                   (unsigned long)q->played[p], 100.0 * q->wins[p] / q->played[p]);
+        }
+    }
+    fprintf(stderr, "[QUERY] %lu rows scanned in %.3fs (%u segments skipped by time)\n",
+            (unsigned long)scanned, elapsed, skipped);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *log_path = "game.log";
+    const char *query = NULL;
+    uint32_t since = 0, until = UINT32_MAX;
+    long synthetic = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:d:q:s:u:G:")) != -1) {
+        switch (opt) {
+            case 'l': log_path = optarg; break;
+            case 'd': idx_dir = optarg; break;
+            case 'q': query = optarg; break;
+            case 's': since = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'u': until = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'G': synthetic = atol(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-l log] [-d dir] | -q games|snakes|win-rate [-s since] [-u until] | -G rows\n", argv[0]);
+                return 1;
+        }
+    }
+    if (query) return run_query(query, since, until);
+    if (synthetic > 0) return generate_synthetic(synthetic);
+    return build_index(log_path);
+}
@@ -0,0 +1,404 @@
+// Deterministic replay of game.log.
+// Re-executes every logged game with the server's own rules (server.c is compiled in
+// without its main) and checks each roll, move and timeout against the record. Rooms
+// play at the same time, so lines are replayed against the room their R<room> tag
+// names; untagged lines from single-room servers belong to room 0. The log is mapped
+// rather than read, and MOVE and TIMEOUT lines, nearly all of it, are parsed by hand
+// in place; only the rare other events go through sscanf.
+//
+//   ./replay [-g game] [-t turn] [logfile]   verify a log, optionally stop at a turn and print the board
+//   ./replay -s seed -p players -n turns     fast-forward a synthetic game and report turns/sec
+
+#define SERVER_NO_MAIN
+#include "server.c"
+
+typedef struct {
+    Room room;
+    bool verifiable;        // Game started with a logged seed
+    bool failed;
+    int game_id;
+} ReplayRoom;
+
+typedef struct {
+    ReplayRoom *rooms;
+    int room_count;
+    ReplayRoom *cur;        // Room of the line being replayed
+    long line_no;
+    int games_ok;
+    int games_failed;
+    int games_legacy;
+    long turns;
+    long mismatches;
+} ReplayState;
+
+#define END_OF_GAME (1 << 30)
+
+static int stop_game = -1;
+static int stop_turn = -1;   // -1: stop when the game ends
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void replay_reset_room(ReplayRoom *rr) {
+    room_init(&rr->room);
+    rr->verifiable = false;
+    rr->failed = false;
+    rr->game_id = -1;
+}
+
+// Rooms are created as the log first mentions them.
+static ReplayRoom *replay_room(ReplayState *rs, int room) {
+    if (room >= rs->room_count) {
+        int count = room + 1;
+        ReplayRoom *rooms = realloc(rs->rooms, sizeof(ReplayRoom) * count);
+        if (!rooms) return NULL;
+        for (int r = rs->room_count; r < count; r++) replay_reset_room(&rooms[r]);
+        rs->rooms = rooms;
+        rs->room_count = count;
+    }
+    return &rs->rooms[room];
+}
+
+static void mismatch(ReplayState *rs, const char *what, int expected, int got) {
+    printf("[REPLAY] line %ld (game %d): %s expected %d, log has %d\n",
+           rs->line_no, rs->cur->game_id, what, expected, got);
+    rs->mismatches++;
+    rs->cur->failed = true;
+}
+
+static void dump_state(ReplayState *rs) {
+    Room *room = &rs->cur->room;
+    GameView view;
+    room_view(room, &view);
+    char *board = render_board(&view);
+    if (!board) return;
+    printf("[REPLAY] Game %d (room %d) before turn %d%s", rs->cur->game_id, (int)(rs->cur - rs->rooms),
+           room->turn_number, board);
+    free(board);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        Player *p = &room->players[i];
+        if (p->state != PLAYER_DISCONNECTED)
+            printf("P%d %-16s pos %d\n", i + 1, p->name, p->position);
+    }
+}
+
+static bool reached_stop(ReplayState *rs, int next_turn) {
+    if (rs->cur->game_id != stop_game || !rs->cur->verifiable) return false;
+    if (stop_turn < 0 ? next_turn != END_OF_GAME : next_turn <= stop_turn) return false;
+    dump_state(rs);
+    return true;
+}
+
+static void finish_game(ReplayState *rs, ReplayRoom *rr) {
+    if (!rr->verifiable) return;
+    if (rr->failed) rs->games_failed++;
+    else rs->games_ok++;
+    rr->verifiable = false;
+}
+
+// Same turn steps as the scheduler's ROLL command: draw_turn, move, then pass_turn
+// unless the roller won.
+static void replay_move(ReplayState *rs, int turn, int player, int roll, int from, int to) {
+    Room *room = &rs->cur->room;
+    if (turn != room->turn_number) mismatch(rs, "turn", room->turn_number, turn);
+    if (player != room->current_player) {
+        mismatch(rs, "player", room->current_player + 1, player + 1);
+        room->current_player = player;
+    }
+    TurnResult r = draw_turn(room);
+    if (roll != r.roll) mismatch(rs, "roll", r.roll, roll);
+    if (from != r.from) mismatch(rs, "from", r.from, from);
+    if (to != r.to) mismatch(rs, "to", r.to, to);
+
+    room->players[player].position = to;
+    room->turn_number = turn;
+    rs->turns++;
+    if (to == BOARD_SIZE) {
+        room->game_state = GAME_FINISHED;
+        room->winner_index = player;
+    } else {
+        pass_turn(room, player);
+    }
+}
+
+// Same transition as the timeout branch of room_tick.
+static void replay_timeout(ReplayState *rs, int turn, int player) {
+    Room *room = &rs->cur->room;
+    if (turn != room->turn_number) mismatch(rs, "turn", room->turn_number, turn);
+    if (player != room->current_player) {
+        mismatch(rs, "timed-out player", room->current_player + 1, player + 1);
+        room->current_player = player;
+    }
+    room->turn_number = turn;
+    rs->turns++;
+    pass_turn(room, player);
+}
+
+// --- Line Scanning ---
+// MOVE and TIMEOUT lines are parsed in place, [p, end) of the mapped log. Every line
+// handed in is followed by a newline (verify_log copies a last line that lacks one),
+// so digit loops stop at it without checking the bound on every byte.
+static inline bool is_digit(char c) { return (unsigned char)(c - '0') < 10; }
+
+// Reads the number at *p; the server never logs one longer than 9 digits.
+static inline bool scan_int(const char **p, int *out) {
+    const char *s = *p;
+    unsigned int v = 0;
+    while (is_digit(*s)) v = v * 10 + (*s++ - '0');
+    if (s == *p || s - *p > 9) return false;
+    *out = (int)v;
+    *p = s;
+    return true;
+}
+
+// Reads the one- to three-digit number (a roll or a cell) that ends at e, returning
+// where it starts or NULL. The digit count varies randomly from line to line, so it
+// is worked out with selects rather than a loop whose exit would be mispredicted.
+// At least three bytes before e must be readable.
+static inline const char *scan_cell_back(const char *e, int *out) {
+    if (!is_digit(e[-1])) return NULL;
+    bool two = is_digit(e[-2]);
+    bool three = two && is_digit(e[-3]);
+    *out = (e[-1] - '0') + (two ? (e[-2] - '0') * 10 : 0) + (three ? (e[-3] - '0') * 100 : 0);
+    return e - 1 - two - three;
+}
+
+// "MOVE: T<turn> P<player> <name> rolled <roll> from <from> to <to>", with "MOVE: "
+// already matched. The numbers after the name are read from the end of the line, so
+// a name is never mistaken for them.
+static bool scan_move(const char *p, const char *end, int *turn, int *player, int *roll, int *from, int *to) {
+    p += 6;
+    if (*p++ != 'T' || !scan_int(&p, turn)) return false;
+    if (end - p < 2 || p[0] != ' ' || p[1] != 'P') return false;
+    p += 2;
+    if (!scan_int(&p, player)) return false;
+    if (end - p < (long)sizeof(" rolled 1 from 0 to 0") - 1) return false;
+
+    const char *e = scan_cell_back(end, to);
+    if (!e || memcmp(e - 4, " to ", 4) != 0) return false;
+    e = scan_cell_back(e - 4, from);
+    if (!e || e - p < 10 || memcmp(e - 6, " from ", 6) != 0) return false;
+    e = scan_cell_back(e - 6, roll);
+    return e && e - p >= 8 && memcmp(e - 8, " rolled ", 8) == 0;
+}
+
+// "TIMEOUT: T<turn> P<player> skipped."
+static bool scan_timeout(const char *p, const char *end, int *turn, int *player) {
+    if (end - p < 10 || memcmp(p, "TIMEOUT: T", 10) != 0) return false;
+    p += 10;
+    if (!scan_int(&p, turn) || end - p < 2 || p[0] != ' ' || p[1] != 'P') return false;
+    p += 2;
+    return scan_int(&p, player);
+}
+
+// Every event line other than MOVE and TIMEOUT, NUL-terminated.
+static bool replay_event(ReplayState *rs, ReplayRoom *rr, const char *msg) {
+    Room *room = &rr->room;
+    int player, game;
+    unsigned int seed;
+
+    if (strncmp(msg, "PLAYER_JOIN: ", 13) == 0) {
+        char name[MAX_NAME_LEN] = "";
+        const char *end = strstr(msg, " connected");
+        int len = end ? (int)(end - (msg + 13)) : 0;
+        if (len >= MAX_NAME_LEN) len = MAX_NAME_LEN - 1;
+        memcpy(name, msg + 13, len);
+        int idx = add_player(room, name, 0);
+        if (end && sscanf(end, " connected as P%d", &player) == 1 && idx != player - 1)
+            mismatch(rs, "join slot", idx + 1, player);
+    }
+    else if (sscanf(msg, "PLAYER_LEAVE: P%d", &player) == 1) {
+        remove_player(room, player - 1);
+    }
+    else if (strncmp(msg, "GAME_START:", 11) == 0) {
+        const char *args = strstr(msg, "game=");
+        if (args && sscanf(args, "game=%d seed=%u", &game, &seed) == 2) {
+            start_game(room, seed);
+            rr->game_id = game;
+            rr->verifiable = true;
+            rr->failed = false;
+        } else {
+            start_game(room, 0);
+            rs->games_legacy++;
+        }
+    }
+    else if (strncmp(msg, "GAME_OVER:", 10) == 0) {
+        if (reached_stop(rs, END_OF_GAME)) return false;
+        if (rr->verifiable && room->game_state != GAME_FINISHED) {
+            printf("[REPLAY] line %ld (game %d): GAME_OVER logged but nobody reached %d\n",
+                   rs->line_no, rr->game_id, BOARD_SIZE);
+            rr->failed = true;
+        }
+        finish_game(rs, rr);
+    }
+    else if (strncmp(msg, "GAME_RESET:", 11) == 0) {
+        finish_game(rs, rr);
+        reset_game(room);
+    }
+    else if (strncmp(msg, "SERVER_START:", 13) == 0) {
+        for (int r = 0; r < rs->room_count; r++) {
+            finish_game(rs, &rs->rooms[r]);
+            replay_reset_room(&rs->rooms[r]);
+        }
+    }
+    return true;
+}
+
+// One line [line, end) of the mapped log. Returns false once the requested stop
+// point has been printed.
+static bool replay_line(ReplayState *rs, const char *line, const char *end) {
+    // The server's ctime() stamp is fixed width: "[Sun Oct 18 19:47:45 2026] ".
+    const char *msg = end - line > 27 && line[25] == ']' ? line + 25 : memchr(line, ']', end - line);
+    msg = msg && end - msg > 1 && msg[1] == ' ' ? msg + 2 : line;
+    // Room tag, as log_message_room reads it.
+    int room_index = 0;
+    const char *tagged = msg + 1;
+    if (msg < end && *msg == 'R' && scan_int(&tagged, &room_index) &&
+        tagged < end && *tagged == ' ' && room_index < MAX_ROOMS) {
+        msg = tagged + 1;
+    } else {
+        room_index = 0;
+    }
+    ReplayRoom *rr = replay_room(rs, room_index);
+    if (!rr) return true;
+    rs->cur = rr;
+
+    int turn, player, roll, from, to;
+    if (end - msg >= 6 && memcmp(msg, "MOVE: ", 6) == 0) {
+        if (!rr->verifiable) return true;
+        if (!scan_move(msg, end, &turn, &player, &roll, &from, &to)) {
+            printf("[REPLAY] line %ld: unparsable move\n", rs->line_no);
+            rr->failed = true;
+            return true;
+        }
+        if (reached_stop(rs, turn)) return false;
+        if (player < 1 || player > MAX_PLAYERS) { mismatch(rs, "player slot", 1, player); return true; }
+        replay_move(rs, turn, player - 1, roll, from, to);
+        return true;
+    }
+    if (scan_timeout(msg, end, &turn, &player)) {
+        if (!rr->verifiable) return true;
+        if (reached_stop(rs, turn)) return false;
+        if (player < 1 || player > MAX_PLAYERS) { mismatch(rs, "player slot", 1, player); return true; }
+        replay_timeout(rs, turn, player - 1);
+        return true;
+    }
+
+    char event[LOG_MSG_LEN + 64];
+    int len = end - msg < (long)sizeof(event) ? (int)(end - msg) : (int)sizeof(event) - 1;
+    memcpy(event, msg, len);
+    event[len] = '\0';
+    return replay_event(rs, rr, event);
+}
+
+static int verify_log(const char *path) {
+    double start = now_seconds();
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror("[REPLAY] Failed to open log");
+        if (fd != -1) close(fd);
+        return 1;
+    }
+    const char *log = NULL;
+    if (st.st_size > 0) {
+        log = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (log == MAP_FAILED) { perror("[REPLAY] Failed to map log"); close(fd); return 1; }
+        madvise((void *)log, st.st_size, MADV_SEQUENTIAL);
+    }
+
+    ReplayState rs = {0};
+    bool stopped = false;
+    const char *p = log, *log_end = log + st.st_size;
+    while (p < log_end) {
+        const char *nl = memchr(p, '\n', log_end - p);
+        rs.line_no++;
+        if (!nl) {
+            char last[LOG_MSG_LEN + 64];
+            int len = log_end - p < (long)sizeof(last) ? (int)(log_end - p) : (int)sizeof(last) - 1;
+            memcpy(last, p, len);
+            last[len] = '\n';
+            stopped = !replay_line(&rs, last, last + len);
+            break;
+        }
+        if (!replay_line(&rs, p, nl)) { stopped = true; break; }
+        p = nl + 1;
+    }
+    double elapsed = now_seconds() - start;
+    if (log) munmap((void *)log, st.st_size);
+    close(fd);
+
+    if (!stopped && stop_game >= 0)
+        printf("[REPLAY] Game %d turn %d not found in %s\n", stop_game, stop_turn, path);
+    for (int r = 0; r < rs.room_count && !stopped; r++)
+        if (rs.rooms[r].verifiable) printf("[REPLAY] Game %d still in progress at end of log.\n", rs.rooms[r].game_id);
+
+    printf("[REPLAY] %ld turns verified in %.3fs (%.1fM turns/sec): %d games verified, %d failed, "
+           "%d legacy (no seed), %ld mismatches\n",
+           rs.turns, elapsed, elapsed > 0 ? rs.turns / elapsed / 1e6 : 0.0,
+           rs.games_ok, rs.games_failed, rs.games_legacy, rs.mismatches);
+    free(rs.rooms);
+    return rs.mismatches || rs.games_failed ? 2 : 0;
+}
+
+// Plays back-to-back games with no log, game N seeded with seed + N.
+static int fast_forward(unsigned int seed, int players, long turns) {
+    Room *room = malloc(sizeof(Room));
+    room_init(room);
+    for (int i = 0; i < players; i++) {
+        char name[MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "P%d", i + 1);
+        add_player(room, name, 0);
+    }
+
+    long games = 0;
+    start_game(room, seed);
+
+    double start = now_seconds();
+    for (long t = 0; t < turns; t++) {
+        if (play_turn(room).to == BOARD_SIZE) {
+            games++;
+            for (int i = 0; i < players; i++) room->players[i].position = 0;
+            start_game(room, seed + (unsigned int)games);
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("[REPLAY] Fast-forward: %ld turns, %ld games finished, %.3fs, %.1fM turns/sec\n",
+           turns, games, elapsed, elapsed > 0 ? turns / elapsed / 1e6 : 0.0);
+    printf("[REPLAY] State: game %ld turn %d, current P%d\n", games, room->turn_number, room->current_player + 1);
+    for (int i = 0; i < players; i++) printf("P%d pos %d\n", i + 1, room->players[i].position);
+    free(room);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int seed = 0;
+    int players = MIN_PLAYERS;
+    long turns = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "g:t:s:p:n:")) != -1) {
+        switch (opt) {
+            case 'g': stop_game = atoi(optarg); break;
+            case 't': stop_turn = atoi(optarg); break;
+            case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'p': players = atoi(optarg); break;
+            case 'n': turns = atol(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-g game] [-t turn] [logfile]\n"
+                                "       %s -s seed -p players -n turns\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+
+    init_game_board();
+    if (turns >= 0) {
+        if (players < 1 || players > MAX_PLAYERS) { fprintf(stderr, "Players must be 1-%d\n", MAX_PLAYERS); return 1; }
+        return fast_forward(seed, players, turns);
+    }
+    return verify_log(optind < argc ? argv[optind] : "game.log");
+}
@@ -15,6 +15,19 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <semaphore.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <stddef.h>
 
 #define PORT 8080
 #define MAX_PLAYERS 5
@@ -23,12 +36,28 @@
 #define BOARD_SIZE 100          
 #define MAX_SNAKES 10
 #define MAX_LADDERS 10
-#define SHM_NAME "/snakeladders_shm_v13" 
+#define SHM_LAYOUT_VERSION 21     // Bump with any change to SharedGameData
+#define SHM_NAME "/snakeladders_shm_v21"
+#define CTL_SOCK_PATH "/tmp/snakeladders_ctl.sock"   // Hot-restart handoff (./server -r)
 #define TURN_TIME_LIMIT 20  
+#define GAME_START_DELAY 5         // Seconds from 3 ready players to GAME_START
+#define GAME_RESET_DELAY 5         // Seconds the finished board stays up
 #define LOG_QUEUE_SIZE 50
 #define LOG_MSG_LEN 128
-
-
+#define CMD_QUEUE_SIZE 256         // Session commands waiting for the scheduler; a power of two
+#define SCHEDULER_TICK_MS 100      // Longest the scheduler sleeps without a command
+#define SCORE_SAVE_MS 1000         // Longest scores.txt lags behind a finished game
+#define SESSION_IN_LEN 64          // Unparsed client input per session
+#define MAX_QUEUED_ROLLS 2         // Rolls a client may send ahead of its turn
+#define BOARD_STR_LEN 704          // Header + 10 rows of "[%4s]" cells, with slack for stacked player markers
+#define MAX_ROOMS 20000            // Games hosted at once: 100k players
+#define SESSION_SLAB 1024          // Sessions allocated together by the session worker
+#define SESSION_OUT_MAX 16384      // Unsent output a client may leave behind before it is dropped
+#define MEMORY_REPORT_CONNS 10000  // Idle connections ./server -m opens by default
+
+// Sessions and the scheduler share atomics through MAP_SHARED memory; that only
+// works if they are real lock-free instructions, not libatomic's process-local locks.
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory needs lock-free atomic int");
 
 typedef struct {
     int start;
@@ -43,13 +72,12 @@ typedef enum {
 } PlayerState;
 
 typedef struct {
-    pid_t pid;
-    int socket_fd;
     char name[MAX_NAME_LEN];
     PlayerState state;
     int position;
-    int total_wins;
     bool is_active;
+    unsigned int token;          // Session holding the seat; commands must carry it
+    unsigned int worker;         // Generation of the session worker serving it
 } Player;
 
 typedef enum {
@@ -64,58 +92,168 @@ typedef struct {
     int wins;
 } ScoreEntry;
 
+// Wins by player name, held by the server process rather than in shared memory and
+// grown as new names win. Names are found through an open-addressed hash.
+typedef struct {
+    pthread_mutex_t lock;        // The scheduler updates, the logger thread saves
+    ScoreEntry *entries;
+    int count;
+    int capacity;                // A power of two; slots holds twice as many
+    int *slots;                  // Entry index + 1 for each name hashed here, 0 if free
+    bool dirty;                  // Changed since scores.txt was written
+} ScoreTable;
+
 typedef struct {
     char message[LOG_MSG_LEN];
 } LogEntry;
 
+// The board never changes once init_game_board() has run at start-up, so every
+// process keeps its own copy instead of sharing (and locking) one.
+typedef struct {
+    SnakeLadder snakes[MAX_SNAKES];
+    SnakeLadder ladders[MAX_LADDERS];
+    int num_snakes;
+    int num_ladders;
+    unsigned char jump[BOARD_SIZE + 1];   // Where a player landing on each cell ends up
+} Board;
+
+// --- Commands ---
+// Sessions never change game state themselves: they queue a command and the
+// scheduler thread, the only writer, applies it.
+typedef enum {
+    CMD_JOIN = 1,
+    CMD_ROLL,
+    CMD_LEAVE,
+    CMD_EVICT                    // From the server: a session worker died, free its seats
+} CommandType;
 
 typedef struct {
-   
-    pthread_mutex_t game_mutex;
-    pthread_mutex_t turn_mutex;
-    pthread_mutex_t player_mutex;
-    pthread_mutex_t board_mutex;
-    pthread_mutex_t score_mutex; 
-    pthread_mutex_t log_mutex;  
-    sem_t turn_sem;
-    sem_t log_sem;              
+    CommandType type;
+    int room;
+    int player;                  // ROLL, LEAVE: seat index
+    int turn;                    // ROLL: the turn it answers; a roll for any other turn is ignored
+    unsigned int token;          // Session token (JOIN: the one to seat)
+    unsigned int worker;         // JOIN: generation of the worker sending it; EVICT: the one that died
+    char name[MAX_NAME_LEN];     // JOIN
+} Command;
+
+typedef struct {
+    atomic_uint seq;             // Which lap of the ring may use the cell next, see command_push
+    Command cmd;
+} CommandCell;
+
+typedef struct {
+    atomic_uint head;            // Next cell a producer claims
+    _Alignas(64) unsigned int tail;   // Next cell the scheduler reads; nobody else touches it
+    CommandCell cells[CMD_QUEUE_SIZE];
+} CommandQueue;
+
+// --- Rooms ---
+typedef struct {
+    int turn;                    // 0: no move yet this game
+    int roll;
+    int from;
+    int to;
+} LastMove;
+
+// What sessions see of a room: a copy the scheduler publishes after every change.
+// Only ints, so it can be published word by word (see publish_view).
+typedef struct {
+    int game_id;
+    int game_state;
+    int current_player;
+    int turn_number;
+    int winner_index;
+    int merge_into;              // Room the players here should move to, -1 if none
+    int state[MAX_PLAYERS];
+    int position[MAX_PLAYERS];
+    unsigned int token[MAX_PLAYERS];
+    LastMove last_move[MAX_PLAYERS];
+} GameView;
+
+#define VIEW_WORDS (sizeof(GameView) / sizeof(int))
 
-    
+// One game. Everything above view_seq is owned by the scheduler thread and never
+// read by sessions.
+typedef struct {
     GameState game_state;
+    int game_id;
     int winner_index;
-    int game_count;
-    bool server_running;
     bool scores_updated_for_game; 
-    
-    
+
     int current_player;
     int turn_number;
-    time_t turn_start_time;
-    
-    
+    long long turn_start_ms;
+    long long timer_ms;          // Start or reset countdown deadline, 0 while none runs
+    unsigned int game_seed;      // Seed logged at GAME_START so the game can be replayed
+    unsigned int rng_state;      // Die state, advanced once per applied roll
+
     Player players[MAX_PLAYERS];
     int total_players;
     int active_players;
-    
-    SnakeLadder snakes[MAX_SNAKES];
-    SnakeLadder ladders[MAX_LADDERS];
-    int num_snakes;
-    int num_ladders;
+    LastMove last_move[MAX_PLAYERS];
+    bool view_dirty;
+    int live_slot;               // Index in the scheduler's live list, -1 while empty and waiting
+    int open_list;               // Scheduler's open list it is on (players seated), -1 if none
+    int open_slot;               // Index in that list
+    int merge_into;              // Room its waiting players are being moved to, -1 if none
+
+    atomic_uint view_seq;
+    atomic_int view[VIEW_WORDS];
+} Room;
+
+typedef struct {
+
+    pthread_mutex_t log_mutex;  
+    sem_t log_sem;              
+    sem_t log_space_sem;         // Free log_queue slots; log_event waits on it
+    sem_t cmd_sem;               // Posted per queued command, wakes the scheduler
+
+    atomic_bool server_running;
+    atomic_uint next_token;
+    atomic_uint worker_generation;   // Session workers started so far, across hot restarts
+    atomic_uint commands_applied;   // Commands the scheduler has applied and published views for
+    atomic_uint view_epoch;      // Bumped by every scheduler pass that changed anything; sessions sleep on it
+    atomic_int open_room;        // Room new players are sent to, -1 while every seat is taken
+    int game_count;              // Game ids are unique across rooms
+    int rooms_used;              // Rooms initialized so far; scheduler only
+
+    CommandQueue cmds;
 
-   
     LogEntry log_queue[LOG_QUEUE_SIZE];
     int log_head;
     int log_tail;
 
-   
-    ScoreEntry score_table[MAX_PLAYERS * 10]; 
-    int unique_players_in_history;
-    
+
+    // Last, and initialized only when first used: a room nobody played in never
+    // touches its pages.
+    Room rooms[MAX_ROOMS];
 } SharedGameData;
 
+// Scheduler timings in ms; the stress test shortens them.
+typedef struct {
+    long long turn_limit;
+    long long start_delay;
+    long long reset_delay;
+} SchedulerTimings;
 
 SharedGameData *g_shm_ptr = NULL;
+pid_t g_worker_pid = -1;
+unsigned int g_worker_gen = 0;   // Generation of g_worker_pid; in the worker, its own
 int g_server_fd = -1;
+int g_shm_fd = -1;
+int g_ctl_fd = -1;
+atomic_bool g_threads_running = true;   // Per process: cleared when handing off to a new binary
+atomic_bool g_logger_running = true;    // Cleared after the scheduler has stopped: it may be waiting in log_event
+Board g_board;
+ScoreTable g_scores = { .lock = PTHREAD_MUTEX_INITIALIZER };
+SchedulerTimings g_timings = { TURN_TIME_LIMIT * 1000, GAME_START_DELAY * 1000, GAME_RESET_DELAY * 1000 };
+
+long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
 int create_shared_memory(const char *name, size_t size) {
     shm_unlink(name);
@@ -130,142 +268,163 @@ void *attach_shared_memory(int shm_fd, size_t size) {
     return (addr == MAP_FAILED) ? NULL : addr;
 }
 
+void publish_view(Room *room);
+
+void room_init(Room *room) {
+    memset(room, 0, sizeof(Room));
+    room->game_state = GAME_WAITING;
+    room->winner_index = -1;
+    room->live_slot = -1;
+    room->open_list = -1;
+    room->merge_into = -1;
+    for (int i = 0; i < MAX_PLAYERS; i++) room->players[i].state = PLAYER_DISCONNECTED;
+}
+
+void command_queue_init(CommandQueue *q) {
+    atomic_init(&q->head, 0);
+    q->tail = 0;
+    for (unsigned int i = 0; i < CMD_QUEUE_SIZE; i++) atomic_init(&q->cells[i].seq, i);
+}
+
 int initialize_sync_primitives(SharedGameData *data) {
     if (!data) return -1;
-    memset(data, 0, sizeof(SharedGameData));
-    
+    memset(data, 0, offsetof(SharedGameData, rooms));
+
     pthread_mutexattr_t mutex_attr;
     pthread_mutexattr_init(&mutex_attr);
     pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
-    
-    pthread_mutex_init(&data->game_mutex, &mutex_attr);
-    pthread_mutex_init(&data->turn_mutex, &mutex_attr);
-    pthread_mutex_init(&data->player_mutex, &mutex_attr);
-    pthread_mutex_init(&data->board_mutex, &mutex_attr);
-    pthread_mutex_init(&data->score_mutex, &mutex_attr);
     pthread_mutex_init(&data->log_mutex, &mutex_attr);
     pthread_mutexattr_destroy(&mutex_attr);
-    
+
     sem_init(&data->log_sem, 1, 0);
-    sem_init(&data->turn_sem, 1, 0);
-    
-    data->game_state = GAME_WAITING;
-    data->winner_index = -1;
+    sem_init(&data->log_space_sem, 1, LOG_QUEUE_SIZE - 1);
+    sem_init(&data->cmd_sem, 1, 0);
+
     data->server_running = true;
+    data->next_token = 1;
+    data->worker_generation = 0;
     data->log_head = 0;
     data->log_tail = 0;
-    data->unique_players_in_history = 0;
-    data->scores_updated_for_game = false;
 
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        data->players[i].state = PLAYER_DISCONNECTED;
-        data->players[i].socket_fd = -1;
-    }
+    command_queue_init(&data->cmds);
+    room_init(&data->rooms[0]);
+    publish_view(&data->rooms[0]);
+    data->rooms_used = 1;
+    atomic_init(&data->open_room, 0);
     return 0;
 }
 
 void cleanup_sync_primitives(SharedGameData *data) {
     if (!data) return;
-    pthread_mutex_destroy(&data->game_mutex);
-    pthread_mutex_destroy(&data->turn_mutex);
-    pthread_mutex_destroy(&data->player_mutex);
-    pthread_mutex_destroy(&data->board_mutex);
-    pthread_mutex_destroy(&data->score_mutex);
     pthread_mutex_destroy(&data->log_mutex);
     sem_destroy(&data->log_sem);
-    sem_destroy(&data->turn_sem);
+    sem_destroy(&data->log_space_sem);
+    sem_destroy(&data->cmd_sem);
 }
 
-void init_game_board(SharedGameData *data) {
-    pthread_mutex_lock(&data->board_mutex);
+void init_game_board(void) {
+    Board *b = &g_board;
     // Snakes
-    data->snakes[0] = (SnakeLadder){98, 78};
-    data->snakes[1] = (SnakeLadder){95, 75};
-    data->snakes[2] = (SnakeLadder){93, 73};
-    data->snakes[3] = (SnakeLadder){87, 24};
-    data->snakes[4] = (SnakeLadder){64, 60};
-    data->snakes[5] = (SnakeLadder){62, 19};
-    data->snakes[6] = (SnakeLadder){54, 34};
-    data->snakes[7] = (SnakeLadder){17, 7};
-    data->num_snakes = 8;
+    b->snakes[0] = (SnakeLadder){98, 78};
+    b->snakes[1] = (SnakeLadder){95, 75};
+    b->snakes[2] = (SnakeLadder){93, 73};
+    b->snakes[3] = (SnakeLadder){87, 24};
+    b->snakes[4] = (SnakeLadder){64, 60};
+    b->snakes[5] = (SnakeLadder){62, 19};
+    b->snakes[6] = (SnakeLadder){54, 34};
+    b->snakes[7] = (SnakeLadder){17, 7};
+    b->num_snakes = 8;
     // Ladders
-    data->ladders[0] = (SnakeLadder){1, 38};
-    data->ladders[1] = (SnakeLadder){4, 14};
-    data->ladders[2] = (SnakeLadder){9, 31};
-    data->ladders[3] = (SnakeLadder){21, 42};
-    data->ladders[4] = (SnakeLadder){28, 84};
-    data->ladders[5] = (SnakeLadder){36, 44};
-    data->ladders[6] = (SnakeLadder){51, 67};
-    data->ladders[7] = (SnakeLadder){71, 91};
-    data->num_ladders = 8;
-    pthread_mutex_unlock(&data->board_mutex);
+    b->ladders[0] = (SnakeLadder){1, 38};
+    b->ladders[1] = (SnakeLadder){4, 14};
+    b->ladders[2] = (SnakeLadder){9, 31};
+    b->ladders[3] = (SnakeLadder){21, 42};
+    b->ladders[4] = (SnakeLadder){28, 84};
+    b->ladders[5] = (SnakeLadder){36, 44};
+    b->ladders[6] = (SnakeLadder){51, 67};
+    b->ladders[7] = (SnakeLadder){71, 91};
+    b->num_ladders = 8;
+
+    for (int i = 0; i <= BOARD_SIZE; i++) b->jump[i] = i;
+    for (int i = 0; i < b->num_snakes; i++) b->jump[b->snakes[i].start] = b->snakes[i].end;
+    for (int i = 0; i < b->num_ladders; i++) b->jump[b->ladders[i].start] = b->ladders[i].end;
 }
 
 // --- Logging ---
+// A full queue makes the caller wait for the logger instead of dropping the line:
+// replay needs every MOVE and TIMEOUT. The wait only gives up once the server stops.
 void log_event(SharedGameData *data, const char *event) {
-    pthread_mutex_lock(&data->log_mutex);
-    int next = (data->log_tail + 1) % LOG_QUEUE_SIZE;
-    if (next != data->log_head) {
-        strncpy(data->log_queue[data->log_tail].message, event, LOG_MSG_LEN - 1);
-        data->log_queue[data->log_tail].message[LOG_MSG_LEN - 1] = '\0';
-        data->log_tail = next;
-        sem_post(&data->log_sem);
+    struct timespec deadline;
+    while (1) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        if (sem_timedwait(&data->log_space_sem, &deadline) == 0) break;
+        if (!data->server_running) return;
     }
+    pthread_mutex_lock(&data->log_mutex);
+    strncpy(data->log_queue[data->log_tail].message, event, LOG_MSG_LEN - 1);
+    data->log_queue[data->log_tail].message[LOG_MSG_LEN - 1] = '\0';
+    data->log_tail = (data->log_tail + 1) % LOG_QUEUE_SIZE;
+    sem_post(&data->log_sem);
     pthread_mutex_unlock(&data->log_mutex);
 }
 
+// Events of one room are tagged "R<room> " so tools can follow each game in an
+// interleaved log.
+void log_room_event(SharedGameData *data, int room, const char *fmt, ...) {
+    char event[LOG_MSG_LEN];
+    int len = snprintf(event, sizeof(event), "R%d ", room);
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(event + len, sizeof(event) - len, fmt, ap);
+    va_end(ap);
+    log_event(data, event);
+}
+
+// Returns the message after its room tag. Untagged lines are server-wide or come
+// from a single-room server; they belong to room 0.
+const char *log_message_room(const char *msg, int *room) {
+    *room = 0;
+    if (msg[0] != 'R' || msg[1] < '0' || msg[1] > '9') return msg;
+    char *end;
+    long r = strtol(msg + 1, &end, 10);
+    if (*end != ' ' || r >= MAX_ROOMS) return msg;
+    *room = (int)r;
+    return end + 1;
+}
 
-void reset_game(SharedGameData *data) {
-    pthread_mutex_lock(&data->game_mutex);
-    pthread_mutex_lock(&data->player_mutex);
-    pthread_mutex_lock(&data->turn_mutex);
 
-    data->game_state = GAME_WAITING;
-    data->winner_index = -1;
-    data->current_player = 0;
-    data->turn_number = 0;
-    data->turn_start_time = 0;
-    data->scores_updated_for_game = false;
-    data->game_count++; 
+// --- Game Rules ---
+// Plain functions of one Room: no locks, no clock, no logging. The scheduler applies
+// them to live rooms; replay, logindex and the tournament step their own rooms with
+// the same functions.
+void reset_game(Room *room) {
+    room->current_player = 0;
+    room->turn_number = 0;
+    room->turn_start_ms = 0;
 
-    
     int count = 0;
     for(int i=0; i<MAX_PLAYERS; i++) {
-        if(data->players[i].state != PLAYER_DISCONNECTED) {
-            data->players[i].position = 0;
-            data->players[i].state = PLAYER_WAITING;
-            data->players[i].is_active = true;
+        if(room->players[i].state != PLAYER_DISCONNECTED) {
+            room->players[i].position = 0;
+            room->players[i].state = PLAYER_WAITING;
+            room->players[i].is_active = true;
             count++;
         }
     }
-    data->active_players = count;
-
-    pthread_mutex_unlock(&data->turn_mutex);
-    pthread_mutex_unlock(&data->player_mutex);
-    pthread_mutex_unlock(&data->game_mutex);
-    
-    log_event(data, "GAME_RESET: Board cleared for new game.");
-}
-
-int get_active_player_count(SharedGameData *data) {
-    pthread_mutex_lock(&data->player_mutex);
-    int count = data->active_players;
-    pthread_mutex_unlock(&data->player_mutex);
-    return count;
-}
+    room->active_players = count;
+    memset(room->last_move, 0, sizeof(room->last_move));
 
-void set_player_position(SharedGameData *data, int player_index, int position) {
-    if (player_index < 0 || player_index >= MAX_PLAYERS) return;
-    pthread_mutex_lock(&data->player_mutex);
-    data->players[player_index].position = position;
-    pthread_mutex_unlock(&data->player_mutex);
+    room->winner_index = -1;
+    room->scores_updated_for_game = false;
+    room->game_state = GAME_WAITING;
 }
 
-int get_next_active_player(SharedGameData *data, int current) {
+int get_next_active_player(Room *room, int current) {
     int next = (current + 1) % MAX_PLAYERS;
     int checked = 0;
     while(checked < MAX_PLAYERS) {
-        if(data->players[next].is_active && data->players[next].state != PLAYER_DISCONNECTED){
+        if(room->players[next].is_active && room->players[next].state != PLAYER_DISCONNECTED){
             return next;
         }
         next = (next + 1) % MAX_PLAYERS;
@@ -274,86 +433,192 @@ int get_next_active_player(SharedGameData *data, int current) {
     return -1;
 }
 
-void advance_turn(SharedGameData *data) {
-    pthread_mutex_lock(&data->turn_mutex);
-    int next = get_next_active_player(data, data->current_player);
+// Hands the turn on from mover.
+void pass_turn(Room *room, int mover) {
+    int next = get_next_active_player(room, mover);
     if (next != -1) {
-        data->current_player = next;
-        data->turn_number++;
-        data->turn_start_time = time(NULL); 
+        room->current_player = next;
+        room->turn_number++;
+    }
+}
+
+// --- Deterministic Die ---
+// xorshift32: every roll of a game follows from game_seed and the turn order alone.
+int next_roll(Room *room) {
+    unsigned int x = room->rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    room->rng_state = x;
+    return (int)(x % 6) + 1;
+}
+
+void seed_game(Room *room, unsigned int seed) {
+    room->game_seed = seed;
+    room->rng_state = seed ? seed : 0x9E3779B9u; // xorshift must not start at 0
+}
+
+// Seeds for live games come from the kernel so players cannot predict the roll sequence.
+unsigned int random_seed(void) {
+    unsigned int seed;
+    if (getrandom(&seed, sizeof(seed), 0) == sizeof(seed)) return seed;
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd != -1) {
+        ssize_t n = read(fd, &seed, sizeof(seed));
+        close(fd);
+        if (n == sizeof(seed)) return seed;
     }
-    pthread_mutex_unlock(&data->turn_mutex);
+    perror("[SCHEDULER] No random source for game seed");
+    return (unsigned int)time(NULL) ^ ((unsigned int)getpid() << 16);
+}
+
+// First turn goes to the lowest seat.
+void start_game(Room *room, unsigned int seed) {
+    seed_game(room, seed);
+    room->current_player = get_next_active_player(room, MAX_PLAYERS - 1);
+    room->turn_number = 1;
+    room->game_state = GAME_PLAYING;
+}
+
+int check_snake_ladder(int position) {
+    if (position < 0 || position > BOARD_SIZE) return position;
+    return g_board.jump[position];
 }
 
-int check_snake_ladder(SharedGameData *data, int position) {
-    pthread_mutex_lock(&data->board_mutex);
-    int new_pos = position;
-    for(int i=0; i<data->num_snakes; i++) 
-        if(data->snakes[i].start == position) new_pos = data->snakes[i].end;
-    for(int i=0; i<data->num_ladders; i++) 
-        if(data->ladders[i].start == position) new_pos = data->ladders[i].end;
-    pthread_mutex_unlock(&data->board_mutex);
-    return new_pos;
+// Board rules for one roll: overshooting 100 keeps the player in place.
+int compute_move(int position, int roll) {
+    int next = position + roll;
+    if (next > BOARD_SIZE) next = position;
+    return g_board.jump[next];
 }
 
-int add_player(SharedGameData *data, const char *name, pid_t pid, int socket_fd) {
-    pthread_mutex_lock(&data->player_mutex);
-    int idx = -1;
+// --- Turn Rules ---
+// One turn is draw_turn() (the current player's roll and where it takes them) followed
+// by moving the player and pass_turn(); play_turn() does all three.
+typedef struct {
+    int player;
+    int turn;
+    int roll;
+    int from;
+    int to;
+} TurnResult;
+
+TurnResult draw_turn(Room *room) {
+    TurnResult r;
+    r.player = room->current_player;
+    r.turn = room->turn_number;
+    r.roll = next_roll(room);
+    r.from = room->players[r.player].position;
+    r.to = compute_move(r.from, r.roll);
+    return r;
+}
+
+TurnResult play_turn(Room *room) {
+    TurnResult r = draw_turn(room);
+    room->players[r.player].position = r.to;
+    if (r.to != BOARD_SIZE) pass_turn(room, r.player);
+    return r;
+}
+
+int add_player(Room *room, const char *name, unsigned int token) {
     for(int i=0; i<MAX_PLAYERS; i++) {
-        if(data->players[i].state == PLAYER_DISCONNECTED) {
-            idx = i;
-            data->players[i].pid = pid;
-            data->players[i].socket_fd = socket_fd;
-            strncpy(data->players[i].name, name, MAX_NAME_LEN - 1);
-            
-            data->players[i].state = PLAYER_WAITING; 
-            
-            data->players[i].position = 0;
-            data->players[i].is_active = true;
-            data->active_players++;
-            data->total_players++;
-            break;
+        if(room->players[i].state == PLAYER_DISCONNECTED) {
+            Player *p = &room->players[i];
+            strncpy(p->name, name, MAX_NAME_LEN - 1);
+            p->name[MAX_NAME_LEN - 1] = '\0';
+            p->token = token;
+            p->state = PLAYER_WAITING;
+            p->position = 0;
+            p->is_active = true;
+            room->active_players++;
+            room->total_players++;
+            return i;
         }
     }
-    pthread_mutex_unlock(&data->player_mutex);
-    return idx;
+    return -1;
 }
 
-void remove_player(SharedGameData *data, int player_index) {
-    if (player_index < 0 || player_index >= MAX_PLAYERS) return;
-    pthread_mutex_lock(&data->player_mutex);
-    if (data->players[player_index].state != PLAYER_DISCONNECTED) {
-        data->players[player_index].state = PLAYER_DISCONNECTED;
-        data->players[player_index].is_active = false;
-        if(data->active_players > 0) data->active_players--;
-    }
-    pthread_mutex_unlock(&data->player_mutex);
+// Returns false if the seat was already empty.
+bool remove_player(Room *room, int player_index) {
+    if (player_index < 0 || player_index >= MAX_PLAYERS) return false;
+    Player *p = &room->players[player_index];
+    if (p->state == PLAYER_DISCONNECTED) return false;
+    p->state = PLAYER_DISCONNECTED;
+    p->is_active = false;
+    if(room->active_players > 0) room->active_players--;
+    return true;
 }
 
-int prepare_new_game(SharedGameData *data) {
-    if (!data) return -1;
-    pthread_mutex_lock(&data->game_mutex);
-    if (data->game_state != GAME_WAITING) {
-        pthread_mutex_unlock(&data->game_mutex);
-        return -1;
-    }
-    pthread_mutex_unlock(&data->game_mutex);
-    
-    pthread_mutex_lock(&data->player_mutex);
+// Players ready for the next game, or -1 while one is running.
+int prepare_new_game(Room *room) {
+    if (room->game_state != GAME_WAITING) return -1;
     int ready = 0;
     for(int i=0; i<MAX_PLAYERS; i++) {
-        if (data->players[i].state == PLAYER_WAITING && data->players[i].is_active) ready++;
+        if (room->players[i].state == PLAYER_WAITING && room->players[i].is_active) ready++;
     }
-    pthread_mutex_unlock(&data->player_mutex);
     return ready;
 }
 
 
 
-void load_scores(SharedGameData *data) {
-    pthread_mutex_lock(&data->score_mutex);
+// Scores are only touched by the scheduler thread (and by tools in their own process).
+unsigned int name_hash(const char *name) {
+    unsigned int h = 2166136261u;   // FNV-1a
+    for (; *name; name++) h = (h ^ (unsigned char)*name) * 16777619u;
+    return h;
+}
+
+void score_link(ScoreTable *t, int index) {
+    unsigned int mask = t->capacity * 2 - 1;
+    unsigned int i = name_hash(t->entries[index].name) & mask;
+    while (t->slots[i]) i = (i + 1) & mask;
+    t->slots[i] = index + 1;
+}
+
+bool score_grow(ScoreTable *t) {
+    int capacity = t->capacity ? t->capacity * 2 : 64;
+    int *slots = calloc(capacity * 2, sizeof(int));
+    ScoreEntry *entries = slots ? realloc(t->entries, sizeof(ScoreEntry) * capacity) : NULL;
+    if (!entries) {
+        free(slots);
+        return false;
+    }
+    free(t->slots);
+    t->entries = entries;
+    t->slots = slots;
+    t->capacity = capacity;
+    for (int i = 0; i < t->count; i++) score_link(t, i);
+    return true;
+}
+
+// The entry for name; with add, a new one with no wins if it has none. NULL if it is
+// not there (or there is no memory for it).
+ScoreEntry *score_find(ScoreTable *t, const char *name, bool add) {
+    if (t->capacity) {
+        unsigned int mask = t->capacity * 2 - 1;
+        for (unsigned int i = name_hash(name) & mask; t->slots[i]; i = (i + 1) & mask) {
+            ScoreEntry *e = &t->entries[t->slots[i] - 1];
+            if (strcmp(e->name, name) == 0) return e;
+        }
+    }
+    if (!add || (t->count == t->capacity && !score_grow(t))) return NULL;
+    ScoreEntry *e = &t->entries[t->count++];
+    snprintf(e->name, MAX_NAME_LEN, "%s", name);
+    e->wins = 0;
+    score_link(t, t->count - 1);
+    return e;
+}
+
+void scores_clear(ScoreTable *t) {
+    t->count = 0;
+    t->dirty = false;
+    if (t->slots) memset(t->slots, 0, sizeof(int) * t->capacity * 2);
+}
+
+void load_scores(ScoreTable *t) {
+    scores_clear(t);
     FILE *file = fopen("scores.txt", "r");
-    
+
     if (!file) {
         printf("[PERSISTENCE] scores.txt not found. Creating new file...\n");
         file = fopen("scores.txt", "w"); 
@@ -363,167 +628,580 @@ void load_scores(SharedGameData *data) {
         } else {
             perror("[PERSISTENCE] Failed to create scores.txt");
         }
-        data->unique_players_in_history = 0;
-        pthread_mutex_unlock(&data->score_mutex);
         return;
     }
 
-    int i = 0;
-    while (fscanf(file, "%s %d", data->score_table[i].name, &data->score_table[i].wins) != EOF) {
-        i++;
-        if(i >= MAX_PLAYERS * 10) break;
+    char format[16], name[MAX_NAME_LEN];
+    int wins;
+    snprintf(format, sizeof(format), "%%%ds %%d", MAX_NAME_LEN - 1);
+    while (fscanf(file, format, name, &wins) == 2) {
+        ScoreEntry *e = score_find(t, name, true);
+        if (!e) break;
+        e->wins += wins;
     }
-    data->unique_players_in_history = i;
     fclose(file);
-    pthread_mutex_unlock(&data->score_mutex);
 }
 
-void save_scores(SharedGameData *data) {
-    FILE *file = fopen("scores.txt", "w");
-    if (file) {
-        for (int i = 0; i < data->unique_players_in_history; i++) {
-            fprintf(file, "%s %d\n", data->score_table[i].name, data->score_table[i].wins);
-        }
-        fflush(file); 
-        fclose(file);
-        printf("[PERSISTENCE] Scores saved to file.\n");
-    } else {
+// Replaces scores.txt whole: a crash mid-write leaves the previous file, not half of one.
+bool save_scores(const ScoreEntry *entries, int count) {
+    FILE *file = fopen("scores.txt.tmp", "w");
+    if (!file) {
         perror("[PERSISTENCE] Failed to write scores.txt");
+        return false;
     }
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s %d\n", entries[i].name, entries[i].wins);
+    }
+    bool ok = fflush(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename("scores.txt.tmp", "scores.txt") == -1) {
+        perror("[PERSISTENCE] Failed to write scores.txt");
+        unlink("scores.txt.tmp");
+        return false;
+    }
+    printf("[PERSISTENCE] Scores saved to file.\n");
+    return true;
 }
 
-void process_score_update(SharedGameData *shm_ptr) {
-    if (shm_ptr->winner_index == -1 || shm_ptr->scores_updated_for_game) return;
+// Writes scores.txt if the table changed since it was last written. The entries are
+// copied under the lock, so the scheduler never waits for the disk.
+void flush_scores(ScoreTable *t) {
+    pthread_mutex_lock(&t->lock);
+    if (!t->dirty) {
+        pthread_mutex_unlock(&t->lock);
+        return;
+    }
+    int count = t->count;
+    ScoreEntry *copy = malloc(sizeof(ScoreEntry) * (count ? count : 1));
+    if (copy) {
+        memcpy(copy, t->entries, sizeof(ScoreEntry) * count);
+        t->dirty = false;
+    }
+    pthread_mutex_unlock(&t->lock);
+    if (!copy) return;
 
-    pthread_mutex_lock(&shm_ptr->score_mutex);
-    
-    char name[MAX_NAME_LEN];
-    strncpy(name, shm_ptr->players[shm_ptr->winner_index].name, MAX_NAME_LEN);
-    
-    bool found = false;
-    for(int i=0; i<shm_ptr->unique_players_in_history; i++) {
-        if(strcmp(shm_ptr->score_table[i].name, name) == 0) {
-            shm_ptr->score_table[i].wins++;
-            found = true; 
-            break;
-        }
+    if (!save_scores(copy, count)) {
+        pthread_mutex_lock(&t->lock);
+        t->dirty = true;             // Tried again on the next flush
+        pthread_mutex_unlock(&t->lock);
     }
-    if(!found && shm_ptr->unique_players_in_history < MAX_PLAYERS * 10) {
-        strcpy(shm_ptr->score_table[shm_ptr->unique_players_in_history].name, name);
-        shm_ptr->score_table[shm_ptr->unique_players_in_history].wins = 1;
-        shm_ptr->unique_players_in_history++;
+    free(copy);
+}
+
+// Counts the room's win; the logger thread saves it within SCORE_SAVE_MS.
+void process_score_update(ScoreTable *t, Room *room) {
+    if (room->winner_index == -1 || room->scores_updated_for_game) return;
+
+    pthread_mutex_lock(&t->lock);
+    ScoreEntry *e = score_find(t, room->players[room->winner_index].name, true);
+    if (e) {
+        e->wins++;
+        t->dirty = true;
     }
-    
-    save_scores(shm_ptr);
-    shm_ptr->scores_updated_for_game = true;
-    
-    pthread_mutex_unlock(&shm_ptr->score_mutex);
+    pthread_mutex_unlock(&t->lock);
+    room->scores_updated_for_game = true;
 }
 
 void* logger_thread(void* arg) {
     SharedGameData *data = (SharedGameData*)arg;
     printf("[LOGGER] Thread started.\n");
-    
-    while (data->server_running) {
-        sem_wait(&data->log_sem);
+    long long saved_ms = now_ms();
+
+    while (data->server_running && g_logger_running) {
+        // Scores changed by finished games are saved here, off the scheduler thread,
+        // at most once per SCORE_SAVE_MS.
+        if (now_ms() - saved_ms >= SCORE_SAVE_MS) {
+            flush_scores(&g_scores);
+            saved_ms = now_ms();
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)SCORE_SAVE_MS * 1000000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        if (sem_timedwait(&data->log_sem, &deadline) != 0) continue;
         if (!data->server_running) break;
 
-        char buffer[LOG_MSG_LEN];
-        bool has_log = false;
-
-        pthread_mutex_lock(&data->log_mutex);
-        if (data->log_head != data->log_tail) {
-            strcpy(buffer, data->log_queue[data->log_head].message);
-            data->log_head = (data->log_head + 1) % LOG_QUEUE_SIZE;
-            has_log = true;
-        }
-        pthread_mutex_unlock(&data->log_mutex);
-
-        if (has_log) {
-            FILE *f = fopen("game.log", "a");
-            if(f) { 
-                time_t now = time(NULL);
-                char *t_str = ctime(&now);
-                t_str[strlen(t_str)-1] = '\0';
-                fprintf(f, "[%s] %s\n", t_str, buffer); 
-                fclose(f); 
+        // Everything queued by now goes out through one open of game.log.
+        FILE *f = fopen("game.log", "a");
+        do {
+            char buffer[LOG_MSG_LEN];
+            bool has_log = false;
+
+            pthread_mutex_lock(&data->log_mutex);
+            if (data->log_head != data->log_tail) {
+                strcpy(buffer, data->log_queue[data->log_head].message);
+                data->log_head = (data->log_head + 1) % LOG_QUEUE_SIZE;
+                has_log = true;
             }
-        }
+            pthread_mutex_unlock(&data->log_mutex);
+
+            if (has_log) {
+                sem_post(&data->log_space_sem);
+                if (f) {
+                    time_t now = time(NULL);
+                    char *t_str = ctime(&now);
+                    t_str[strlen(t_str)-1] = '\0';
+                    fprintf(f, "[%s] %s\n", t_str, buffer); 
+                }
+            }
+        } while (sem_trywait(&data->log_sem) == 0);
+        if (f) fclose(f);
     }
     return NULL;
 }
 
 
-void* scheduler_thread(void* arg) {
-    SharedGameData *data = (SharedGameData*)arg;
-    printf("[SCHEDULER] Started. Limit: %ds per turn.\n", TURN_TIME_LIMIT);
-    
-    while (data->server_running) {
-        pthread_mutex_lock(&data->game_mutex);
-        GameState state = data->game_state;
-        pthread_mutex_unlock(&data->game_mutex);
-
-        if (state == GAME_WAITING) {
-            if (prepare_new_game(data) >= MIN_PLAYERS) {
-                printf("[SCHEDULER] 3+ Players Ready. Starting in 5s...\n");
-                sleep(5); 
-                pthread_mutex_lock(&data->game_mutex);
-                if (get_active_player_count(data) >= MIN_PLAYERS) {
-                    data->game_state = GAME_PLAYING;
-                    data->turn_number = 1;
-                    data->turn_start_time = time(NULL);
-                    printf("[SCHEDULER] Game Started!\n");
-                    log_event(data, "GAME_START: New game began.");
+// --- Command Queue ---
+// Vyukov's bounded queue over shared memory. A producer claims a cell by advancing
+// head with a CAS, fills it, then hands it over by storing seq = position + 1; the
+// scheduler, the only consumer, reads it and frees it for the next lap with
+// seq = position + CMD_QUEUE_SIZE. No lock is ever held, so a session process that
+// stalls or dies cannot block anyone outside the single cell it claimed.
+// Returns false if the queue is full; position (if given) is the command's index.
+bool command_push(SharedGameData *data, const Command *cmd, unsigned int *position) {
+    CommandQueue *q = &data->cmds;
+    unsigned int pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    CommandCell *cell;
+    while (1) {
+        cell = &q->cells[pos & (CMD_QUEUE_SIZE - 1)];
+        unsigned int seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+    cell->cmd = *cmd;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    if (position) *position = pos;
+    sem_post(&data->cmd_sem);
+    return true;
+}
+
+// Scheduler only.
+bool command_pop(CommandQueue *q, Command *out) {
+    CommandCell *cell = &q->cells[q->tail & (CMD_QUEUE_SIZE - 1)];
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) != q->tail + 1) return false;
+    *out = cell->cmd;
+    atomic_store_explicit(&cell->seq, q->tail + CMD_QUEUE_SIZE, memory_order_release);
+    q->tail++;
+    return true;
+}
+
+// True once the scheduler has applied the command at position, and the views
+// reflect it.
+bool command_applied(SharedGameData *data, unsigned int position) {
+    unsigned int applied = atomic_load_explicit(&data->commands_applied, memory_order_acquire);
+    return (int)(applied - position) > 0;
+}
+
+// --- Published Views ---
+void room_view(const Room *room, GameView *v) {
+    memset(v, 0, sizeof(*v));
+    v->game_id = room->game_id;
+    v->game_state = room->game_state;
+    v->current_player = room->current_player;
+    v->turn_number = room->turn_number;
+    v->winner_index = room->winner_index;
+    v->merge_into = room->merge_into;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        const Player *p = &room->players[i];
+        v->state[i] = p->state;
+        v->position[i] = p->position;
+        v->token[i] = p->token;
+        v->last_move[i] = room->last_move[i];
+    }
+}
+
+// A seqlock of atomic words: view_seq is odd while the scheduler rewrites the view.
+// Words are stored with release and loaded with acquire, so a reader that picks up
+// any word of a newer view is guaranteed to see the changed view_seq and retry.
+// No plain memory is shared, so there is nothing for TSAN to flag.
+void publish_view(Room *room) {
+    GameView v;
+    room_view(room, &v);
+    const int *src = (const int *)&v;
+    unsigned int seq = atomic_load_explicit(&room->view_seq, memory_order_relaxed);
+    atomic_store_explicit(&room->view_seq, seq + 1, memory_order_relaxed);
+    for (size_t i = 0; i < VIEW_WORDS; i++)
+        atomic_store_explicit(&room->view[i], src[i], memory_order_release);
+    atomic_store_explicit(&room->view_seq, seq + 2, memory_order_release);
+    room->view_dirty = false;
+}
+
+// The futex is not process-private, so sessions in other processes wake as well.
+void wake_view_waiters(SharedGameData *data) {
+    atomic_fetch_add_explicit(&data->view_epoch, 1, memory_order_release);
+    syscall(SYS_futex, (void *)&data->view_epoch, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Sleeps until the scheduler moves past epoch (read before looking at the views) or
+// timeout_ms passes.
+void wait_for_views(SharedGameData *data, unsigned int epoch, int timeout_ms) {
+    struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    syscall(SYS_futex, (void *)&data->view_epoch, FUTEX_WAIT, epoch, &ts, NULL, 0);
+}
+
+// Returns the view_seq of the copy read.
+unsigned int read_view(Room *room, GameView *v) {
+    int *dst = (int *)v;
+    unsigned int before, after;
+    do {
+        before = atomic_load_explicit(&room->view_seq, memory_order_acquire);
+        for (size_t i = 0; i < VIEW_WORDS; i++)
+            dst[i] = atomic_load_explicit(&room->view[i], memory_order_acquire);
+        after = atomic_load_explicit(&room->view_seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return before;
+}
+
+
+// --- Scheduler ---
+// The single writer of every Room. Each pass applies the queued commands, runs the
+// timers (start countdown, turn limit, reset) of the rooms that have players,
+// publishes the views that changed and only then advances commands_applied.
+// Nothing here blocks except log_event waiting for the logger.
+
+// What the scheduler tracks besides the rooms themselves. Process-local: a new
+// scheduler rebuilds it from the rooms, so a hot restart carries on where the old
+// one stopped.
+typedef struct {
+    int *live;                   // Rooms with players or a game to wind up
+    int live_count;
+    int *dirty;                  // Rooms changed in this pass, to publish
+    int dirty_count;
+    int *open[MAX_PLAYERS];      // Rooms that take players, by how many are seated
+    int open_count[MAX_PLAYERS];
+} SchedulerRooms;
+
+int room_seated(const Room *room) {
+    int n = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        if (room->players[i].state != PLAYER_DISCONNECTED) n++;
+    return n;
+}
+
+void room_touch(SchedulerRooms *sr, SharedGameData *data, Room *room) {
+    if (room->view_dirty) return;
+    room->view_dirty = true;
+    sr->dirty[sr->dirty_count++] = (int)(room - data->rooms);
+}
+
+// Keeps the live list to the rooms room_tick has anything to do for.
+void room_update_live(SchedulerRooms *sr, SharedGameData *data, int r) {
+    Room *room = &data->rooms[r];
+    bool live = room->game_state != GAME_WAITING || room_seated(room) > 0;
+    if (live && room->live_slot == -1) {
+        room->live_slot = sr->live_count;
+        sr->live[sr->live_count++] = r;
+    } else if (!live && room->live_slot != -1) {
+        int last = sr->live[--sr->live_count];
+        sr->live[room->live_slot] = last;
+        data->rooms[last].live_slot = room->live_slot;
+        room->live_slot = -1;
+    }
+}
+
+// A room takes new players between games while it has a free seat, unless its
+// players are being moved out.
+bool room_takes_players(const Room *room) {
+    return room->game_state != GAME_PLAYING && room->merge_into == -1 && room_seated(room) < MAX_PLAYERS;
+}
+
+// Keeps the room on the open list for its seat count, so placing players never scans
+// the rooms.
+void room_update_open(SchedulerRooms *sr, SharedGameData *data, int r) {
+    Room *room = &data->rooms[r];
+    int list = room_takes_players(room) ? room_seated(room) : -1;
+    if (list == room->open_list) return;
+    if (room->open_list != -1) {
+        int *rooms = sr->open[room->open_list];
+        int last = rooms[--sr->open_count[room->open_list]];
+        rooms[room->open_slot] = last;
+        data->rooms[last].open_slot = room->open_slot;
+    }
+    room->open_list = list;
+    if (list != -1) {
+        room->open_slot = sr->open_count[list];
+        sr->open[list][sr->open_count[list]++] = r;
+    }
+}
+
+// Where JOINs go next: the room between games with the most players and a free seat,
+// so arrivals make up games instead of waiting apart; else a new room, else any free
+// seat (its player waits for that room's next game). Returns -1 when every seat is
+// taken.
+int find_open_room(SharedGameData *data, SchedulerRooms *sr) {
+    for (int k = MAX_PLAYERS - 1; k >= 0; k--)
+        if (sr->open_count[k]) return sr->open[k][0];
+    if (data->rooms_used < MAX_ROOMS) {
+        int r = data->rooms_used++;
+        room_init(&data->rooms[r]);
+        publish_view(&data->rooms[r]);
+        room_update_open(sr, data, r);
+        return r;
+    }
+    for (int r = 0; r < data->rooms_used; r++)
+        if (data->rooms[r].merge_into == -1 && room_seated(&data->rooms[r]) < MAX_PLAYERS) return r;
+    return -1;
+}
+
+// Players waiting in a room too empty to start are moved to the fullest other room
+// between games with seats for all of them (on a tie, the lower room). The scheduler
+// cannot move a session, so it publishes merge_into and each session leaves and
+// joins the target itself; a JOIN that finds the target full goes to open_room like
+// any other. The room takes players again once the last one has left.
+void merge_waiting_rooms(SharedGameData *data, SchedulerRooms *sr) {
+    for (int k = 1; k < MIN_PLAYERS; k++) {
+        for (int i = 0; i < sr->open_count[k]; i++) {
+            int from = sr->open[k][i];
+            Room *room = &data->rooms[from];
+            if (room->game_state != GAME_WAITING) continue;
+            int to = -1;
+            for (int j = MAX_PLAYERS - k; j >= k && to == -1; j--) {
+                for (int t = 0; t < sr->open_count[j]; t++) {
+                    int r = sr->open[j][t];
+                    if (r != from && (j > k || r < from)) { to = r; break; }
                 }
-                pthread_mutex_unlock(&data->game_mutex);
             }
+            if (to == -1) continue;
+            room->merge_into = to;
+            printf("[SCHEDULER] R%d: %d waiting, moving them to R%d.\n", from, k, to);
+            log_room_event(data, from, "ROOM_MERGE: Players moving to R%d.", to);
+            publish_view(room);
+            room_update_open(sr, data, from);   // Takes it off open[k]: look at slot i again
+            i--;
         }
-        else if (state == GAME_FINISHED) {
-           
-            if (!data->scores_updated_for_game) {
-                printf("[SCHEDULER] Processing scores...\n");
-                process_score_update(data);
-            }
-            
-            
-            printf("[SCHEDULER] Game Finished. Waiting 5s before reset...\n");
-            sleep(5); 
-            reset_game(data);
-            printf("[SCHEDULER] Game Reset complete.\n");
-        }
-        else if (state == GAME_PLAYING) {
-            pthread_mutex_lock(&data->turn_mutex);
-            time_t now = time(NULL);
-            double elapsed = difftime(now, data->turn_start_time);
-            
-            if (elapsed > TURN_TIME_LIMIT) {
-                int current = data->current_player;
-                printf("[SCHEDULER] Timeout! P%d skipped.\n", current);
-                log_event(data, "TIMEOUT: Player skipped.");
-
-                int next = get_next_active_player(data, current);
-                if (next != -1) {
-                    data->current_player = next;
-                    data->turn_number++;
-                    data->turn_start_time = now;
-                }
+    }
+}
+
+bool seat_owned(Room *room, const Command *cmd) {
+    if (cmd->player < 0 || cmd->player >= MAX_PLAYERS) return false;
+    Player *p = &room->players[cmd->player];
+    return p->state != PLAYER_DISCONNECTED && p->token == cmd->token;
+}
+
+// Frees a seat whose session is gone.
+void room_vacate(SharedGameData *data, SchedulerRooms *sr, int r, int player) {
+    Room *room = &data->rooms[r];
+    remove_player(room, player);
+    if (room->merge_into != -1 && room_seated(room) == 0) room->merge_into = -1;
+    log_room_event(data, r, "PLAYER_LEAVE: P%d disconnected.", player + 1);
+    room_touch(sr, data, room);
+}
+
+// A dead worker never sends the LEAVEs for its sessions: free every seat it served.
+void evict_worker(SharedGameData *data, SchedulerRooms *sr, unsigned int worker) {
+    int evicted = 0;
+    for (int r = 0; r < data->rooms_used; r++) {
+        Room *room = &data->rooms[r];
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            if (room->players[i].state == PLAYER_DISCONNECTED || room->players[i].worker != worker) continue;
+            room_vacate(data, sr, r, i);
+            evicted++;
+        }
+    }
+    printf("[SCHEDULER] Session worker %u gone: %d seats freed.\n", worker, evicted);
+}
+
+void apply_command(SharedGameData *data, SchedulerRooms *sr, const Command *cmd, long long now) {
+    if (cmd->type == CMD_EVICT) {
+        evict_worker(data, sr, cmd->worker);
+        return;
+    }
+    if (cmd->room < 0 || cmd->room >= data->rooms_used) return;
+    int r = cmd->room;
+    Room *room = &data->rooms[r];
+
+    if (cmd->type == CMD_JOIN) {
+        if (room->merge_into != -1) return;   // Being emptied: the session tries open_room
+        int idx = add_player(room, cmd->name, cmd->token);
+        if (idx == -1) return;   // Full: the session finds no seat with its token and tries elsewhere
+        room->players[idx].worker = cmd->worker;
+        printf("[GAME] R%d P%d (%s) Joined.\n", r, idx + 1, room->players[idx].name);
+        log_room_event(data, r, "PLAYER_JOIN: %.*s connected as P%d.",
+                       MAX_NAME_LEN - 1, room->players[idx].name, idx + 1);
+    }
+    else if (cmd->type == CMD_LEAVE) {
+        if (!seat_owned(room, cmd)) return;
+        room_vacate(data, sr, r, cmd->player);
+    }
+    else if (cmd->type == CMD_ROLL) {
+        // A roll for a turn that already timed out is dropped here, whatever the session thought.
+        if (!seat_owned(room, cmd) || room->game_state != GAME_PLAYING ||
+            room->current_player != cmd->player || room->turn_number != cmd->turn) return;
+        TurnResult m = play_turn(room);
+        room->last_move[m.player] = (LastMove){ m.turn, m.roll, m.from, m.to };
+        log_room_event(data, r, "MOVE: T%d P%d %.*s rolled %d from %d to %d",
+                       m.turn, m.player + 1, MAX_NAME_LEN - 1, room->players[m.player].name, m.roll, m.from, m.to);
+
+        if (m.to == BOARD_SIZE) {
+            room->game_state = GAME_FINISHED;
+            room->winner_index = m.player;
+            log_room_event(data, r, "GAME_OVER: We have a winner. P%d", m.player + 1);
+        } else {
+            room->turn_start_ms = now;
+        }
+    }
+    room_touch(sr, data, room);
+}
+
+void room_tick(SharedGameData *data, SchedulerRooms *sr, Room *room, long long now) {
+    int r = (int)(room - data->rooms);
+
+    if (room->game_state == GAME_WAITING) {
+        if (prepare_new_game(room) < MIN_PLAYERS) {
+            room->timer_ms = 0;              // Someone left during the countdown
+            return;
+        }
+        if (!room->timer_ms) {
+            printf("[SCHEDULER] R%d: 3+ Players Ready. Starting in %llds...\n", r, g_timings.start_delay / 1000);
+            room->timer_ms = now + g_timings.start_delay;
+        }
+        if (now < room->timer_ms) return;
+        room->timer_ms = 0;
+        room->game_id = data->game_count++;
+        start_game(room, random_seed());
+        room->turn_start_ms = now;
+        printf("[SCHEDULER] R%d: Game %d Started! Seed %u\n", r, room->game_id, room->game_seed);
+        log_room_event(data, r, "GAME_START: New game began. game=%d seed=%u", room->game_id, room->game_seed);
+    }
+    else if (room->game_state == GAME_PLAYING) {
+        if (room->active_players == 0) {
+            // Everyone left mid-game: free the room for new players.
+            reset_game(room);
+            log_room_event(data, r, "GAME_RESET: Board cleared for new game.");
+            printf("[SCHEDULER] R%d: Game abandoned.\n", r);
+        } else {
+            if (now - room->turn_start_ms <= g_timings.turn_limit) return;
+            int current = room->current_player;
+            printf("[SCHEDULER] R%d: Timeout! P%d skipped.\n", r, current + 1);
+            log_room_event(data, r, "TIMEOUT: T%d P%d skipped.", room->turn_number, current + 1);
+            pass_turn(room, current);
+            room->turn_start_ms = now;
+        }
+    }
+    else if (room->game_state == GAME_FINISHED) {
+        if (!room->timer_ms) {
+            if (!room->scores_updated_for_game) {
+                printf("[SCHEDULER] R%d: Processing scores...\n", r);
+                process_score_update(&g_scores, room);
             }
-            pthread_mutex_unlock(&data->turn_mutex);
+            printf("[SCHEDULER] R%d: Game Finished. Waiting %llds before reset...\n", r, g_timings.reset_delay / 1000);
+            room->timer_ms = now + g_timings.reset_delay;
         }
-        sleep(1);
+        if (now < room->timer_ms) return;
+        room->timer_ms = 0;
+        reset_game(room);
+        log_room_event(data, r, "GAME_RESET: Board cleared for new game.");
+        printf("[SCHEDULER] R%d: Game Reset complete.\n", r);
     }
-    return NULL;
+    room_touch(sr, data, room);
+}
+
+// Milliseconds until room_tick has something to do for the room, at most SCHEDULER_TICK_MS.
+long long room_next_tick(Room *room, long long now) {
+    long long due = now + SCHEDULER_TICK_MS;
+    if (room->game_state == GAME_WAITING && prepare_new_game(room) >= MIN_PLAYERS)
+        due = room->timer_ms ? room->timer_ms : now;
+    else if (room->game_state == GAME_PLAYING)
+        due = room->active_players ? room->turn_start_ms + g_timings.turn_limit + 1 : now;
+    else if (room->game_state == GAME_FINISHED)
+        due = room->timer_ms ? room->timer_ms : now;
+    if (due < now) return 0;
+    return due - now < SCHEDULER_TICK_MS ? due - now : SCHEDULER_TICK_MS;
+}
+
+// Sleeps until a command is queued or timeout_ms passes.
+void wait_for_commands(SharedGameData *data, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)timeout_ms * 1000000;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+    if (sem_timedwait(&data->cmd_sem, &deadline) == 0) {
+        while (sem_trywait(&data->cmd_sem) == 0);   // One pass drains them all
+    }
+}
+
+void scheduler_rooms_free(SchedulerRooms *sr) {
+    free(sr->live);
+    free(sr->dirty);
+    for (int k = 0; k < MAX_PLAYERS; k++) free(sr->open[k]);
 }
 
-void generate_board_string(SharedGameData *data, char *board_str, int buffer_size) {
-    pthread_mutex_lock(&data->player_mutex);
-    pthread_mutex_lock(&data->board_mutex);
+void* scheduler_thread(void* arg) {
+    SharedGameData *data = (SharedGameData*)arg;
+    printf("[SCHEDULER] Started. Limit: %llds per turn.\n", g_timings.turn_limit / 1000);
+    SchedulerRooms sr = { .live = malloc(sizeof(int) * MAX_ROOMS), .dirty = malloc(sizeof(int) * MAX_ROOMS) };
+    bool lists = sr.live && sr.dirty;
+    for (int k = 0; k < MAX_PLAYERS; k++) lists = (sr.open[k] = malloc(sizeof(int) * MAX_ROOMS)) && lists;
+    if (!lists) {
+        perror("[SCHEDULER] Room lists");
+        scheduler_rooms_free(&sr);
+        return NULL;
+    }
+    for (int r = 0; r < data->rooms_used; r++) {
+        data->rooms[r].live_slot = -1;
+        data->rooms[r].open_list = -1;
+        room_update_live(&sr, data, r);
+        room_update_open(&sr, data, r);
+    }
+    unsigned int applied = atomic_load_explicit(&data->commands_applied, memory_order_relaxed);
+
+    while (data->server_running && g_threads_running) {
+        long long now = now_ms();
+        long long wait = SCHEDULER_TICK_MS;
+        for (int i = 0; i < sr.live_count && wait > 0; i++) {
+            long long due = room_next_tick(&data->rooms[sr.live[i]], now);
+            if (due < wait) wait = due;
+        }
+        if (wait > 0) wait_for_commands(data, (int)wait);
+        now = now_ms();
+
+        // Bounded so a flood of commands cannot starve the timers.
+        Command cmd;
+        int n = 0;
+        for (; n < CMD_QUEUE_SIZE && command_pop(&data->cmds, &cmd); n++) {
+            apply_command(data, &sr, &cmd, now);
+            applied++;
+        }
+        for (int i = 0; i < sr.live_count; i++) room_tick(data, &sr, &data->rooms[sr.live[i]], now);
+
+        bool changed = sr.dirty_count > 0 || n > 0;
+        for (int i = 0; i < sr.dirty_count; i++) {
+            int r = sr.dirty[i];
+            publish_view(&data->rooms[r]);
+            room_update_live(&sr, data, r);
+            room_update_open(&sr, data, r);
+        }
+        if (sr.dirty_count > 0) {
+            merge_waiting_rooms(data, &sr);
+            // Before commands_applied: a session whose JOIN found its room full
+            // retries with the room published here.
+            atomic_store_explicit(&data->open_room, find_open_room(data, &sr), memory_order_relaxed);
+        }
+        sr.dirty_count = 0;
+
+        atomic_store_explicit(&data->commands_applied, applied, memory_order_release);
+        if (changed) wake_view_waiters(data);
+    }
+    scheduler_rooms_free(&sr);
+    return NULL;
+}
 
+// Renders a view; the board itself is immutable.
+void generate_board_string(const GameView *view, char *board_str, int buffer_size) {
+    const Board *b = &g_board;
     int player_pos[MAX_PLAYERS] = {0};
     for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (data->players[i].is_active && data->players[i].state != PLAYER_DISCONNECTED) {
-            player_pos[i] = data->players[i].position;
-        }
+        if (view->state[i] != PLAYER_DISCONNECTED) player_pos[i] = view->position[i];
     }
 
     char temp[30];
@@ -538,19 +1216,19 @@ void generate_board_string(SharedGameData *data, char *board_str, int buffer_siz
             for (int col = 10; col >= 1; col--) {
                 int cell = pos;
                 char marker[20] = "";
-                
+
                 for (int p = 0; p < MAX_PLAYERS; p++) 
                     if (player_pos[p] == cell) {
                         char p_id[5];
                         sprintf(p_id, "P%d", p+1);
                         strcat(marker, p_id);
                     }
-                
+
                 if (strlen(marker) == 0) {
-                     for(int s=0; s<data->num_snakes; s++) 
-                        if(data->snakes[s].start == cell) snprintf(marker, sizeof(marker), "S%d", s+1);
-                     for(int l=0; l<data->num_ladders; l++) 
-                        if(data->ladders[l].start == cell) snprintf(marker, sizeof(marker), "L%d", l+1);
+                     for(int s=0; s<b->num_snakes; s++)
+                        if(b->snakes[s].start == cell) snprintf(marker, sizeof(marker), "S%d", s+1);
+                     for(int l=0; l<b->num_ladders; l++)
+                        if(b->ladders[l].start == cell) snprintf(marker, sizeof(marker), "L%d", l+1);
                      if(strlen(marker)==0) snprintf(marker, sizeof(marker), "%d", cell);
                 }
                 snprintf(temp, sizeof(temp), "[%4s]", marker);
@@ -569,10 +1247,10 @@ void generate_board_string(SharedGameData *data, char *board_str, int buffer_siz
                         strcat(marker, p_id);
                     }
                 if (strlen(marker) == 0) {
-                     for(int s=0; s<data->num_snakes; s++) 
-                        if(data->snakes[s].start == cell) snprintf(marker, sizeof(marker), "S%d", s+1);
-                     for(int l=0; l<data->num_ladders; l++) 
-                        if(data->ladders[l].start == cell) snprintf(marker, sizeof(marker), "L%d", l+1);
+                     for(int s=0; s<b->num_snakes; s++)
+                        if(b->snakes[s].start == cell) snprintf(marker, sizeof(marker), "S%d", s+1);
+                     for(int l=0; l<b->num_ladders; l++)
+                        if(b->ladders[l].start == cell) snprintf(marker, sizeof(marker), "L%d", l+1);
                      if(strlen(marker)==0) snprintf(marker, sizeof(marker), "%d", cell);
                 }
                 snprintf(temp, sizeof(temp), "[%4s]", marker);
@@ -583,132 +1261,838 @@ void generate_board_string(SharedGameData *data, char *board_str, int buffer_siz
         strcat(board_str, line);
         strcat(board_str, "\n");
     }
-    pthread_mutex_unlock(&data->board_mutex);
-    pthread_mutex_unlock(&data->player_mutex);
+}
+
+// Caller frees the returned string.
+char *render_board(const GameView *view) {
+    char *board = malloc(BOARD_STR_LEN);
+    if (board) generate_board_string(view, board, BOARD_STR_LEN);
+    return board;
 }
 
 
-void handle_client(int client_sock, SharedGameData *shm_ptr) {
-    srand(time(NULL) ^ getpid());
-    char buffer[4096];
+// --- Client Sessions ---
+// Every connection of a server is served by its session worker process (see
+// session_worker) from a Session: a fixed-size record carved from a slab, with no
+// process, thread or stack of its own. Output goes straight to the socket; only
+// what the socket will not take yet is copied to a buffer, freed once it drains.
+// An idle connection costs its Session and nothing else in user space.
+//
+// A session reads its room only through published views and changes it only by
+// queueing commands. Input is parsed into commands as soon as it arrives, so a
+// ROLL sent ahead of the turn (auto-play) is queued and goes to the scheduler the
+// moment a view shows the turn. Every ROLL carries the number of the turn it
+// answers, and the scheduler ignores it for any other turn. A turn that times out
+// takes its rolls with it: anything queued is dropped, and if the YOUR_TURN prompt
+// was never answered, its late answer is dropped when it comes.
+typedef enum {
+    SESSION_NAME = 0,            // Reading the player's name (or refused, closing)
+    SESSION_JOINING,             // JOIN queued, not applied yet
+    SESSION_SEATED,
+    SESSION_CLOSED               // Client gone before its JOIN was applied
+} SessionPhase;
+
+typedef struct Session {
+    int sock;
+    SessionPhase phase;
+    int room;
+    int player_index;
+    unsigned int token;
+    unsigned int join_position;  // Queue position of the pending JOIN
     char name[MAX_NAME_LEN];
-    int bytes_read, my_player_index = -1;
-    bool game_over_sent = false;
-
-    
-    send(client_sock, "Enter Name: ", 12, 0);
-    memset(name, 0, MAX_NAME_LEN);
-    bytes_read = recv(client_sock, name, MAX_NAME_LEN-1, 0);
-    if (bytes_read <= 0) { close(client_sock); return; }
-    name[strcspn(name, "\n")] = 0;
-    
-    
-    my_player_index = add_player(shm_ptr, name, getpid(), client_sock);
-    if (my_player_index == -1) {
-        send(client_sock, "Server Full.\n", 13, 0);
-        close(client_sock); return;
-    }
-    
-    printf("[GAME] P%d (%s) Joined.\n", my_player_index + 1, name);
-    char log_buf[64];
-    snprintf(log_buf, sizeof(log_buf), "PLAYER_JOIN: %s connected.", name);
-    log_event(shm_ptr, log_buf);
-
-   
-    while (shm_ptr->server_running) {
-        pthread_mutex_lock(&shm_ptr->game_mutex);
-        GameState state = shm_ptr->game_state;
-        pthread_mutex_unlock(&shm_ptr->game_mutex);
+    char in_buf[SESSION_IN_LEN];
+    int in_len;
+    int queued_rolls;
+    int stale_rolls;           // Late answers to skipped prompts, discarded on arrival
+    int game_id;               // Game and turn of the turn being handled
+    int turn;
+    bool prompted;             // YOUR_TURN sent, no roll queued for it yet
+    bool rolled;               // ROLL queued, result not seen yet
+    bool game_over_sent;
+    char *out;                 // Output the socket has not taken yet; NULL almost always
+    int out_len;
+    struct Session *next;      // Free list, or the worker's joining list
+} Session;
+
+// The worker's side of a room: which of its sessions sit there.
+typedef struct {
+    unsigned int seen_seq;     // view_seq last passed on to them
+    int sessions;
+    int hosted_slot;           // Index in Worker.hosted while sessions > 0
+    Session *seat[MAX_PLAYERS];
+} WorkerRoom;
+
+typedef struct {
+    SharedGameData *shm;
+    int epfd;
+    int listen_fd;             // -1 once handed off
+    int bell_fd;               // eventfd rung by the doorbell thread
+    Session *slab;             // Sessions are carved from here, SESSION_SLAB at a time
+    int slab_used;
+    Session *free_sessions;
+    long sessions;             // Open connections
+    Session *joining;
+    WorkerRoom *rooms;         // MAX_ROOMS of them; pages of unused rooms stay untouched
+    int *hosted;               // Rooms with a session of this worker
+    int hosted_count;
+} Worker;
+
+Worker g_worker;
+volatile sig_atomic_t g_worker_draining = 0;
+
+void worker_drain_handler(int sig) { g_worker_draining = 1; }
+
+Session *session_alloc(Worker *w) {
+    Session *s = w->free_sessions;
+    if (s) {
+        w->free_sessions = s->next;
+    } else {
+        if (!w->slab || w->slab_used == SESSION_SLAB) {
+            // Never freed: released sessions go to the free list for the next connection.
+            w->slab = malloc(sizeof(Session) * SESSION_SLAB);
+            w->slab_used = 0;
+            if (!w->slab) return NULL;
+        }
+        s = &w->slab[w->slab_used++];
+    }
+    memset(s, 0, sizeof(*s));
+    return s;
+}
+
+void session_free(Worker *w, Session *s) {
+    free(s->out);
+    s->out = NULL;
+    s->next = w->free_sessions;
+    w->free_sessions = s;
+}
+
+void session_watch(Session *s, bool want_output) {
+    struct epoll_event ev = { .events = EPOLLIN | (want_output ? EPOLLOUT : 0), .data.ptr = s };
+    epoll_ctl(g_worker.epfd, EPOLL_CTL_MOD, s->sock, &ev);
+}
 
-        if (state == GAME_WAITING || state == GAME_PLAYING) {
-            game_over_sent = false;
+// Sends what the socket takes now and keeps the rest for EPOLLOUT. Returns -1 once
+// the client has left SESSION_OUT_MAX bytes unread.
+int session_write(Session *s, const char *buf, int len) {
+    if (!s->out) {
+        int sent = send(s->sock, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return -1;
+            sent = 0;
         }
+        if (sent == len) return 0;
+        buf += sent;
+        len -= sent;
+        session_watch(s, true);
+    }
+    if (s->out_len + len > SESSION_OUT_MAX) return -1;
+    char *out = realloc(s->out, s->out_len + len);
+    if (!out) return -1;
+    memcpy(out + s->out_len, buf, len);
+    s->out = out;
+    s->out_len += len;
+    return 0;
+}
+
+void session_flush(Session *s) {
+    int sent = send(s->sock, s->out, s->out_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) shutdown(s->sock, SHUT_RDWR);
+        return;
+    }
+    s->out_len -= sent;
+    memmove(s->out, s->out + sent, s->out_len);
+    if (s->out_len == 0) {
+        free(s->out);
+        s->out = NULL;
+        session_watch(s, false);
+    }
+}
+
+// A client that cannot be written to is shut down rather than closed here: the
+// worker closes it when it reads the EOF, the one place a Session is released.
+int session_send(Session *s, const char *fmt, ...) {
+    char out[BOARD_STR_LEN + 128];   // The longest message: a prompt or result with the board
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(out, sizeof(out), fmt, ap);
+    va_end(ap);
+    if (len < 0) return -1;
+    if (len >= (int)sizeof(out)) len = sizeof(out) - 1;
+    if (session_write(s, out, len) == -1) {
+        shutdown(s->sock, SHUT_RDWR);
+        return -1;
+    }
+    return len;
+}
 
-        if (state == GAME_WAITING) { 
-            usleep(1000000); // Wait 1s
+// Consumes complete commands from in_buf. Commands are "ROLL", optionally newline
+// terminated (older clients send a bare "ROLL"); anything else is discarded up to the
+// next newline. A partial "RO" stays buffered until the rest arrives.
+void session_parse_commands(Session *s) {
+    int i = 0;
+    while (i < s->in_len) {
+        char c = s->in_buf[i];
+        if (c == '\n' || c == '\r' || c == ' ') { i++; continue; }
+
+        int left = s->in_len - i;
+        if (left >= 4 && strncmp(&s->in_buf[i], "ROLL", 4) == 0) {
+            if (s->stale_rolls > 0) s->stale_rolls--;
+            else if (s->queued_rolls < MAX_QUEUED_ROLLS) s->queued_rolls++;
+            i += 4;
             continue; 
         }
-        
-        if (state == GAME_FINISHED) {
-             if (!game_over_sent) {
-                 if (shm_ptr->winner_index != -1) {
-                     sprintf(buffer, "GAME_OVER|Winner: P%d! Auto-restarting in 5s...", shm_ptr->winner_index + 1);
-                     send(client_sock, buffer, strlen(buffer), 0);
-                 }
-                 game_over_sent = true;
-             }
-             sleep(1); continue;
-        }
-
-        if (state == GAME_PLAYING) {
-            pthread_mutex_lock(&shm_ptr->turn_mutex);
-            int current = shm_ptr->current_player;
-            pthread_mutex_unlock(&shm_ptr->turn_mutex);
-            
-            if (current == my_player_index) {
-               
-                char board_buf[2048];
-                generate_board_string(shm_ptr, board_buf, sizeof(board_buf));
-                sprintf(buffer, "YOUR_TURN|%s\nYour Turn! Press Enter to Roll...", board_buf);
-                send(client_sock, buffer, strlen(buffer), 0);
-                
-                char temp[10];
-                recv(client_sock, temp, sizeof(temp), 0);
-                
-                pthread_mutex_lock(&shm_ptr->turn_mutex);
-                if (shm_ptr->current_player != my_player_index) {
-                    pthread_mutex_unlock(&shm_ptr->turn_mutex);
-                    send(client_sock, "RESULT|Too Slow! Turn Skipped.\n", 30, 0);
-                    continue;
-                }
-                pthread_mutex_unlock(&shm_ptr->turn_mutex);
-                
-                int roll = (rand() % 6) + 1;
-                
-                pthread_mutex_lock(&shm_ptr->player_mutex);
-                int pos = shm_ptr->players[my_player_index].position;
-                pthread_mutex_unlock(&shm_ptr->player_mutex);
-                
-                int next = pos + roll;
-                if (next > 100) next = pos; 
-
-                int final = check_snake_ladder(shm_ptr, next);
-                set_player_position(shm_ptr, my_player_index, final);
-
-                snprintf(log_buf, sizeof(log_buf), "MOVE: %s rolled %d to %d", name, roll, final);
-                log_event(shm_ptr, log_buf);
-
-                char event_msg[64] = "";
-                if (final > next) sprintf(event_msg, " (LADDER! Up to %d)", final);
-                if (final < next) sprintf(event_msg, " (SNAKE! Down to %d)", final);
-
-                generate_board_string(shm_ptr, board_buf, sizeof(board_buf));
-                sprintf(buffer, "RESULT|Rolled %d -> Moved to %d%s\n%s", roll, final, event_msg, board_buf);
-                send(client_sock, buffer, strlen(buffer), 0);
-                
-                if (final == 100) {
-                    pthread_mutex_lock(&shm_ptr->game_mutex);
-                    shm_ptr->game_state = GAME_FINISHED;
-                    shm_ptr->winner_index = my_player_index;
-                    pthread_mutex_unlock(&shm_ptr->game_mutex);
-
-                    log_event(shm_ptr, "GAME_OVER: We have a winner.");
-
-                    sprintf(buffer, "GAME_OVER|Winner: P%d! Auto-restarting in 5s...", my_player_index + 1);
-                    send(client_sock, buffer, strlen(buffer), 0);
-                    game_over_sent = true;
-
-                    
-                } else {
-                    advance_turn(shm_ptr);
-                }
+        if (left < 4 && strncmp(&s->in_buf[i], "ROLL", left) == 0) break;
+
+        char *nl = memchr(&s->in_buf[i], '\n', left);
+        i = nl ? (int)(nl - s->in_buf) + 1 : s->in_len;
+    }
+    memmove(s->in_buf, s->in_buf + i, s->in_len - i);
+    s->in_len -= i;
+}
+
+// Buffers whatever input is available. Returns -1 once the client has disconnected.
+int session_read_input(Session *s) {
+    if (s->in_len == SESSION_IN_LEN) session_parse_commands(s);
+    int n = recv(s->sock, s->in_buf + s->in_len, SESSION_IN_LEN - s->in_len, MSG_DONTWAIT);
+    if (n == 0) return -1;
+    if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    s->in_len += n;
+    return 0;
+}
+
+// Takes the first line (the player name) from the input buffer once it is complete;
+// bytes after it are kept for the command parser.
+bool session_take_name(Session *s) {
+    char *nl = memchr(s->in_buf, '\n', s->in_len);
+    if (!nl && s->in_len < MAX_NAME_LEN - 1) return false;
+    int len = nl ? (int)(nl - s->in_buf) : MAX_NAME_LEN - 1;
+    if (len > MAX_NAME_LEN - 1) len = MAX_NAME_LEN - 1;
+    memcpy(s->name, s->in_buf, len);
+    s->name[len] = '\0';
+    s->name[strcspn(s->name, "\r")] = '\0';
+    int used = nl ? (int)(nl - s->in_buf) + 1 : len;
+    memmove(s->in_buf, s->in_buf + used, s->in_len - used);
+    s->in_len -= used;
+    return true;
+}
+
+// Queues a command, waiting for room while the queue is full.
+bool session_command(Session *s, SharedGameData *shm_ptr, CommandType type, unsigned int *position) {
+    Command cmd = { .type = type, .room = s->room, .player = s->player_index, .turn = s->turn,
+                    .token = s->token, .worker = g_worker_gen };
+    if (type == CMD_JOIN) memcpy(cmd.name, s->name, MAX_NAME_LEN);
+    while (!command_push(shm_ptr, &cmd, position)) {
+        if (!shm_ptr->server_running) return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+// Brings the client up to date with the latest view of its room: the result of its
+// roll or the skip of its turn, the next prompt, the end of the game.
+void session_update(Session *s, SharedGameData *shm_ptr, const GameView *v) {
+    int me = s->player_index;
+    bool my_turn = v->game_state == GAME_PLAYING && v->current_player == me;
+    bool same_turn = v->game_id == s->game_id && v->turn_number == s->turn;
+    char board[BOARD_STR_LEN];
+
+    if (s->prompted || s->rolled) {
+        const LastMove *m = &v->last_move[me];
+        if (v->game_state != GAME_WAITING && v->game_id == s->game_id && m->turn == s->turn) {
+            int next = m->from + m->roll;
+            if (next > BOARD_SIZE) next = m->from;
+            char event_msg[64] = "";
+            if (m->to > next) sprintf(event_msg, " (LADDER! Up to %d)", m->to);
+            if (m->to < next) sprintf(event_msg, " (SNAKE! Down to %d)", m->to);
+
+            generate_board_string(v, board, sizeof(board));
+            session_send(s, "RESULT|Rolled %d -> Moved to %d%s\n%s", m->roll, m->to, event_msg, board);
+            s->prompted = s->rolled = false;
+        } else if (!my_turn || !same_turn) {
+            // The turn moved on without our roll: it timed out first.
+            bool answered = s->rolled || s->queued_rolls > 0 || s->in_len > 0;
+            if (s->prompted && !answered) s->stale_rolls = 1;
+            s->prompted = s->rolled = false;
+            s->queued_rolls = 0;
+            s->in_len = 0;
+            session_send(s, "RESULT|Too Slow! Turn Skipped.\n");
+        }
+    }
+
+    if (v->game_state == GAME_FINISHED) {
+        if (!s->game_over_sent) {
+            if (v->winner_index != -1)
+                session_send(s, "GAME_OVER|Winner: P%d! Auto-restarting in 5s...", v->winner_index + 1);
+            s->game_over_sent = true;
+            s->queued_rolls = 0; // Rolls queued for the finished game do not carry over
+        }
+        return;
+    }
+    s->game_over_sent = false;
+    if (!my_turn) return;
+
+    if (!same_turn) {
+        s->game_id = v->game_id;
+        s->turn = v->turn_number;
+        s->prompted = s->rolled = false;
+        // A roll that is already queued is applied right away, without the prompt round trip.
+        if (s->queued_rolls == 0) {
+            generate_board_string(v, board, sizeof(board));
+            session_send(s, "YOUR_TURN|%s\nYour Turn! Press Enter to Roll...", board);
+            s->prompted = true;
+        }
+    }
+    if (!s->rolled && s->queued_rolls > 0 && session_command(s, shm_ptr, CMD_ROLL, NULL)) {
+        s->queued_rolls--;
+        s->prompted = false;
+        s->rolled = true;
+    }
+}
+
+// --- Session Worker ---
+// One process serves all of a server's connections from an epoll loop: accepting,
+// reading names and commands, and passing each room's published views on to the
+// players sitting there. The doorbell thread turns the scheduler's view_epoch futex
+// into eventfd readiness, so the loop sleeps in epoll_wait and nowhere else.
+// After a hot restart hands the server off (SIGUSR1), the worker stops accepting and
+// exits once its last client has gone; the new server's worker takes the new ones.
+
+// Sends the session's JOIN to the room given, or with -1 to the room new players go
+// to. False if every seat is taken.
+bool session_join(Worker *w, Session *s, int room) {
+    s->room = room != -1 ? room : atomic_load_explicit(&w->shm->open_room, memory_order_acquire);
+    if (s->room < 0 || !session_command(s, w->shm, CMD_JOIN, &s->join_position)) {
+        s->phase = SESSION_NAME;
+        return false;
+    }
+    s->phase = SESSION_JOINING;
+    s->next = w->joining;
+    w->joining = s;
+    return true;
+}
+
+void worker_seat(Worker *w, Session *s, int seat) {
+    WorkerRoom *wr = &w->rooms[s->room];
+    if (wr->sessions++ == 0) {
+        wr->hosted_slot = w->hosted_count;
+        w->hosted[w->hosted_count++] = s->room;
+    }
+    wr->seat[seat] = s;
+    s->player_index = seat;
+    s->phase = SESSION_SEATED;
+    s->game_id = -1;
+}
+
+void worker_unseat(Worker *w, Session *s) {
+    WorkerRoom *wr = &w->rooms[s->room];
+    wr->seat[s->player_index] = NULL;
+    if (--wr->sessions == 0) {
+        int last = w->hosted[--w->hosted_count];
+        w->hosted[wr->hosted_slot] = last;
+        w->rooms[last].hosted_slot = wr->hosted_slot;
+    }
+}
+
+// Passes a seated session its room's view, or moves it when the scheduler is
+// merging the room into a fuller one.
+void session_follow(Worker *w, Session *s, const GameView *v) {
+    if (v->merge_into == -1) {
+        session_update(s, w->shm, v);
+        return;
+    }
+    session_command(s, w->shm, CMD_LEAVE, NULL);
+    worker_unseat(w, s);
+    s->queued_rolls = 0;
+    s->prompted = s->rolled = false;
+    session_send(s, "Moving you to a room with more players...\n");
+    if (!session_join(w, s, v->merge_into)) {
+        session_send(s, "Server Full.\n");
+        shutdown(s->sock, SHUT_RDWR);
+    }
+}
+
+void session_close(Worker *w, Session *s) {
+    close(s->sock);
+    w->sessions--;
+    if (s->phase == SESSION_JOINING) {
+        s->phase = SESSION_CLOSED;   // Released by worker_settle_joins once the JOIN is applied
+        return;
+    }
+    if (s->phase == SESSION_SEATED) {
+        session_command(s, w->shm, CMD_LEAVE, NULL);
+        worker_unseat(w, s);
+    }
+    session_free(w, s);
+}
+
+// Seats the sessions whose JOIN the scheduler has applied. One that finds no seat
+// with its token lost the room to other joins and tries the room open now.
+void worker_settle_joins(Worker *w) {
+    Session **link = &w->joining;
+    while (*link) {
+        Session *s = *link;
+        if (!command_applied(w->shm, s->join_position)) { link = &s->next; continue; }
+        *link = s->next;
+
+        GameView v;
+        read_view(&w->shm->rooms[s->room], &v);
+        int seat = -1;
+        for (int i = 0; i < MAX_PLAYERS; i++)
+            if (v.state[i] != PLAYER_DISCONNECTED && v.token[i] == s->token) seat = i;
+
+        if (s->phase == SESSION_CLOSED) {
+            if (seat != -1) {
+                s->player_index = seat;
+                session_command(s, w->shm, CMD_LEAVE, NULL);
+            }
+            session_free(w, s);
+        } else if (seat == -1) {
+            if (!session_join(w, s, -1)) {
+                session_send(s, "Server Full.\n");
+                shutdown(s->sock, SHUT_RDWR);
+            }
+        } else {
+            worker_seat(w, s, seat);
+            session_parse_commands(s);
+            session_follow(w, s, &v);
+        }
+    }
+}
+
+// Runs on every doorbell: passes each changed room's view to its sessions here.
+void worker_deliver_views(Worker *w) {
+    worker_settle_joins(w);
+    // Backwards: a session that moves out may take its room off the list, which
+    // swaps the last room into this slot.
+    for (int i = w->hosted_count - 1; i >= 0; i--) {
+        int r = w->hosted[i];
+        Room *room = &w->shm->rooms[r];
+        WorkerRoom *wr = &w->rooms[r];
+        if (atomic_load_explicit(&room->view_seq, memory_order_acquire) == wr->seen_seq) continue;
+        GameView v;
+        wr->seen_seq = read_view(room, &v);
+        for (int p = 0; p < MAX_PLAYERS; p++)
+            if (wr->seat[p]) session_follow(w, wr->seat[p], &v);
+    }
+}
+
+void worker_accept(Worker *w) {
+    int sock;
+    while (w->listen_fd != -1 && (sock = accept(w->listen_fd, NULL, NULL)) >= 0) {
+        Session *s = session_alloc(w);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = s };
+        if (!s || epoll_ctl(w->epfd, EPOLL_CTL_ADD, sock, &ev) == -1) {
+            close(sock);
+            if (s) session_free(w, s);
+            continue;
+        }
+        s->sock = sock;
+        s->room = -1;
+        s->player_index = -1;
+        s->game_id = -1;
+        w->sessions++;
+        session_send(s, "Enter Name: ");
+    }
+}
+
+void session_event(Worker *w, Session *s, uint32_t events) {
+    if ((events & EPOLLOUT) && s->out) session_flush(s);
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) return;
+    if (session_read_input(s) < 0) {
+        session_close(w, s);
+        return;
+    }
+    if (s->phase == SESSION_NAME) {
+        if (s->token || !session_take_name(s)) return;   // A refused session has its token
+        s->token = atomic_fetch_add(&w->shm->next_token, 1);
+        if (!session_join(w, s, -1)) {
+            session_send(s, "Server Full.\n");
+            shutdown(s->sock, SHUT_RDWR);
+        }
+        return;
+    }
+    session_parse_commands(s);
+    if (s->phase != SESSION_SEATED) return;
+    GameView v;
+    read_view(&w->shm->rooms[s->room], &v);
+    session_follow(w, s, &v);
+}
+
+void* doorbell_thread(void* arg) {
+    Worker *w = (Worker*)arg;
+    unsigned int seen = atomic_load_explicit(&w->shm->view_epoch, memory_order_acquire);
+    while (1) {
+        unsigned int epoch = atomic_load_explicit(&w->shm->view_epoch, memory_order_acquire);
+        if (epoch != seen || !w->shm->server_running) {
+            seen = epoch;
+            eventfd_write(w->bell_fd, 1);
+        }
+        wait_for_views(w->shm, epoch, 1000);
+    }
+    return NULL;
+}
+
+void session_worker(int listen_fd, SharedGameData *shm_ptr) {
+    Worker *w = &g_worker;
+    memset(w, 0, sizeof(*w));
+    w->shm = shm_ptr;
+    w->listen_fd = listen_fd;
+    w->rooms = calloc(MAX_ROOMS, sizeof(WorkerRoom));
+    w->hosted = malloc(sizeof(int) * MAX_ROOMS);
+    w->epfd = epoll_create1(0);
+    w->bell_fd = eventfd(0, EFD_NONBLOCK);
+    if (!w->rooms || !w->hosted || w->epfd == -1 || w->bell_fd == -1) {
+        perror("[WORKER] Setup failed");
+        exit(1);
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &w->listen_fd };
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.ptr = &w->bell_fd;
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->bell_fd, &ev);
+    pthread_t t_bell;
+    pthread_create(&t_bell, NULL, doorbell_thread, w);
+    printf("[WORKER] Serving connections (pid %d).\n", getpid());
+
+    struct epoll_event events[64];
+    while (shm_ptr->server_running) {
+        if (g_worker_draining && w->listen_fd != -1) {
+            epoll_ctl(w->epfd, EPOLL_CTL_DEL, w->listen_fd, NULL);
+            close(w->listen_fd);
+            w->listen_fd = -1;
+            printf("[WORKER] Handed off. %ld clients still connected.\n", w->sessions);
+        }
+        if (w->listen_fd == -1 && w->sessions == 0 && !w->joining) break;
+
+        int n = epoll_wait(w->epfd, events, 64, 1000);
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &w->listen_fd) {
+                worker_accept(w);
+            } else if (tag == &w->bell_fd) {
+                eventfd_t rings;
+                eventfd_read(w->bell_fd, &rings);
+                worker_deliver_views(w);
             } else {
-                usleep(200000); 
+                session_event(w, (Session*)tag, events[i].events);
             }
         }
     }
-    remove_player(shm_ptr, my_player_index);
-    close(client_sock);
+    printf("[WORKER] Exiting.\n");
+}
+
+// --- Memory Report (./server -m [connections]) ---
+// Starts a session worker on a private copy of the shared state and an ephemeral
+// port, opens real connections to it that give a name and then stay idle (rooms
+// fill and wait for a game that never starts), and reads from /proc how much the
+// worker's private memory grew per connection. Kernel memory behind each socket
+// (socket, TCP control block, epoll entry) is not visible there and not counted.
+long process_private_bytes(pid_t pid) {
+    long kb = 0, value;
+    char path[64], line[128];
+    snprintf(path, sizeof(path), "/proc/%d/smaps_rollup", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "Private_Dirty: %ld kB", &value) == 1) kb += value;
+    fclose(f);
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    f = fopen(path, "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f))
+            if (sscanf(line, "VmPTE: %ld kB", &value) == 1) kb += value;
+        fclose(f);
+    }
+    return kb * 1024;
+}
+
+long count_seated(SharedGameData *data) {
+    long seated = 0;
+    for (int r = 0; r < MAX_ROOMS; r++) {
+        if (!atomic_load(&data->rooms[r].view_seq)) break;   // Rooms are opened in order
+        GameView v;
+        read_view(&data->rooms[r], &v);
+        for (int i = 0; i < MAX_PLAYERS; i++) seated += v.state[i] != PLAYER_DISCONNECTED;
+    }
+    return seated;
+}
+
+// Opens connections [from, to) and waits until the scheduler has seated them all.
+long open_idle_connections(int port, int *socks, long from, long to, SharedGameData *data) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    for (long i = from; i < to; i++) {
+        socks[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (socks[i] == -1 || connect(socks[i], (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            perror("[MEMORY] Connect");
+            return i;
+        }
+        char name[MAX_NAME_LEN];
+        int len = snprintf(name, sizeof(name), "idle%ld\n", i);
+        send(socks[i], name, len, MSG_NOSIGNAL);
+        // Let the worker keep up with the accept backlog.
+        if ((i + 1) % 512 == 0 || i + 1 == to) {
+            for (int waited = 0; count_seated(data) < i + 1 && waited < 10000; waited += 10) usleep(10000);
+        }
+    }
+    return to;
+}
+
+void print_memory_report(long conns) {
+    FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+    // The scheduler and worker print every join; only the report goes to stdout.
+    if (!out || !freopen("/dev/null", "w", stdout)) return;
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    getrlimit(RLIMIT_NOFILE, &rl);
+    long warmup = 100;
+    long limit = (long)rl.rlim_cur - warmup - 64;
+    if (limit > MAX_ROOMS * MAX_PLAYERS - warmup) limit = MAX_ROOMS * MAX_PLAYERS - warmup;
+    if (conns > limit) {
+        fprintf(out, "[MEMORY] Open file limit allows %ld connections.\n", limit);
+        conns = limit;
+    }
+    if (conns < 1) return;
+
+    char dir[] = "/tmp/snl_memory_XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) == -1) { perror("[MEMORY] Temp dir"); return; }
+    SharedGameData *data = mmap(NULL, sizeof(SharedGameData), PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) { perror("[MEMORY] mmap"); return; }
+    initialize_sync_primitives(data);
+    g_timings.start_delay = 24LL * 3600 * 1000;   // Full rooms wait instead of playing
+
+    pthread_t t_sched, t_log;
+    pthread_create(&t_sched, NULL, scheduler_thread, data);
+    pthread_create(&t_log, NULL, logger_thread, data);
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd == -1 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+        listen(listen_fd, SOMAXCONN) == -1 || getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) == -1) {
+        perror("[MEMORY] Listen");
+        return;
+    }
+    fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+    pid_t worker = fork();
+    if (worker == 0) {
+        session_worker(listen_fd, data);
+        _exit(0);
+    }
+    close(listen_fd);
+
+    // The first connections pay for one-time setup (first slab, epoll, the doorbell's stack).
+    int *socks = malloc(sizeof(int) * (warmup + conns));
+    int port = ntohs(addr.sin_port);
+    long opened = socks ? open_idle_connections(port, socks, 0, warmup, data) : 0;
+    usleep(200000);
+    long before = process_private_bytes(worker);
+    if (opened == warmup) opened = open_idle_connections(port, socks, warmup, warmup + conns, data);
+    usleep(200000);
+    long after = process_private_bytes(worker);
+    long measured = opened - warmup;
+    long seated = count_seated(data);
+
+    if (measured > 0 && before >= 0 && after >= 0) {
+        double per_conn = (double)(after - before) / measured;
+        long per_room = sizeof(Room) + 2 * sizeof(int);   // Shared state, scheduler's live and dirty lists
+        long total_conns = (long)MAX_ROOMS * MAX_PLAYERS;
+        fprintf(out, "[MEMORY] %ld idle connections (%ld seated in %d rooms) on one session worker\n",
+                measured, seated, data->rooms_used);
+        fprintf(out, "[MEMORY]   worker private memory (Private_Dirty + page tables): %ld -> %ld bytes\n",
+                before, after);
+        fprintf(out, "[MEMORY]   per idle connection: %.0f bytes (Session %zu, worker room slot %zu per %d players)\n",
+                per_conn, sizeof(Session), sizeof(WorkerRoom), MAX_PLAYERS);
+        fprintf(out, "[MEMORY]   kernel socket and epoll memory per connection not included\n");
+        fprintf(out, "[MEMORY] Per active room: %ld bytes of shared state (players, turn state, published view)\n",
+                per_room);
+        fprintf(out, "[MEMORY] Server-wide: command queue %zu, log queue %zu bytes; scores %zu bytes per player who won\n",
+                sizeof(CommandQueue), sizeof(((SharedGameData*)0)->log_queue),
+                sizeof(ScoreEntry) + 2 * sizeof(int));
+        fprintf(out, "[MEMORY] At %ld connections in %d rooms: connections %.1f MB + rooms %.1f MB = %.1f MB\n",
+                total_conns, MAX_ROOMS, total_conns * per_conn / 1e6, (double)MAX_ROOMS * per_room / 1e6,
+                (total_conns * per_conn + (double)MAX_ROOMS * per_room) / 1e6);
+    } else {
+        fprintf(out, "[MEMORY] Measurement failed: %ld of %ld connections opened.\n", measured, conns);
+    }
+    fflush(out);
+
+    kill(worker, SIGKILL);
+    waitpid(worker, NULL, 0);
+    for (long i = 0; i < opened; i++) close(socks[i]);
+    free(socks);
+    data->server_running = false;
+    g_threads_running = false;
+    sem_post(&data->cmd_sem);
+    sem_post(&data->log_sem);
+    pthread_join(t_sched, NULL);
+    pthread_join(t_log, NULL);
+    cleanup_sync_primitives(data);
+    munmap(data, sizeof(SharedGameData));
+    unlink("game.log");
+    unlink("scores.txt");
+    if (chdir("/") == 0) rmdir(dir);
+}
+
+// --- Hot Restart ---
+// A running server listens on CTL_SOCK_PATH. "./server -r" connects there and receives
+// the listening socket and the shared memory fd via SCM_RIGHTS, attaches to the live
+// state without re-initializing it, and starts accepting at once; connections that
+// arrive meanwhile wait in the kernel backlog. The old process then stops its
+// scheduler/logger threads, tells its session worker to stop accepting, sends
+// HANDOFF_DONE so the new threads can start, and exits. The old worker keeps serving
+// its clients on the shared segment until they leave: their commands wait in the
+// queue until the new scheduler picks them up.
+//
+// The fds travel with the old binary's SHM_LAYOUT_VERSION and sizeof(SharedGameData).
+// A successor built with a different layout answers HANDOFF_REFUSE and exits, and
+// the old server carries on serving; only HANDOFF_ACCEPT makes it stop.
+#define HANDOFF_FDS 'F'
+#define HANDOFF_ACCEPT 'A'
+#define HANDOFF_REFUSE 'R'
+#define HANDOFF_DONE 'D'
+#define HANDOFF_REPLY_TIMEOUT 5     // Seconds the old server waits for accept/refuse
+
+typedef struct {
+    char tag;
+    unsigned int layout_version;
+    unsigned long shm_size;
+} HandoffHeader;
+
+int create_control_socket(void) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, CTL_SOCK_PATH, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    unlink(CTL_SOCK_PATH);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, 1) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int send_fds(int conn, int *fds, int count) {
+    HandoffHeader hdr = { .tag = HANDOFF_FDS, .layout_version = SHM_LAYOUT_VERSION,
+                          .shm_size = sizeof(SharedGameData) };
+    struct iovec iov = { .iov_base = &hdr, .iov_len = sizeof(hdr) };
+    char ctrl[CMSG_SPACE(sizeof(int) * 2)];
+    memset(ctrl, 0, sizeof(ctrl));
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1,
+                          .msg_control = ctrl, .msg_controllen = CMSG_SPACE(sizeof(int) * count) };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+    return sendmsg(conn, &msg, 0) == sizeof(hdr) ? 0 : -1;
+}
+
+// Fills hdr with whatever header arrived (a short one from an older binary leaves
+// layout_version 0); returns -1 unless count fds came with it.
+int recv_fds(int conn, int *fds, int count, HandoffHeader *hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    struct iovec iov = { .iov_base = hdr, .iov_len = sizeof(*hdr) };
+    char ctrl[CMSG_SPACE(sizeof(int) * 2)];
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1,
+                          .msg_control = ctrl, .msg_controllen = CMSG_SPACE(sizeof(int) * count) };
+    if (recvmsg(conn, &msg, 0) < 1 || hdr->tag != HANDOFF_FDS) return -1;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * count)) return -1;
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * count);
+    return 0;
+}
+
+// Old server side. Returns only if the successor refused (or never answered), in
+// which case this server keeps running; otherwise shared state stays live for it.
+void handoff_to_successor(int conn, pthread_t t_sched, pthread_t t_log) {
+    int fds[2] = { g_server_fd, g_shm_fd };
+    if (send_fds(conn, fds, 2) == -1) {
+        perror("[HANDOFF] Failed to send fds");
+        close(conn);
+        return;
+    }
+    struct timeval tv = { .tv_sec = HANDOFF_REPLY_TIMEOUT };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char reply = 0;
+    if (recv(conn, &reply, 1, 0) != 1 || reply != HANDOFF_ACCEPT) {
+        fprintf(stderr, "[HANDOFF] Successor refused the takeover. Still serving.\n");
+        close(conn);
+        return;
+    }
+    printf("[HANDOFF] Listening socket and state passed on. Stopping threads...\n");
+
+    // The scheduler first: until it has stopped it may be waiting in log_event for
+    // the logger to free a slot.
+    g_threads_running = false;
+    sem_post(&g_shm_ptr->cmd_sem);
+    pthread_join(t_sched, NULL);
+    g_logger_running = false;
+    sem_post(&g_shm_ptr->log_sem);
+    pthread_join(t_log, NULL);
+    flush_scores(&g_scores);             // The successor loads them once we are done
+    if (g_worker_pid > 0) kill(g_worker_pid, SIGUSR1);
+
+    char done = HANDOFF_DONE;
+    send(conn, &done, 1, MSG_NOSIGNAL);
+    close(conn);
+    printf("[HANDOFF] Done. Exiting.\n");
+    exit(0);
+}
+
+// New server side. Returns the connection to the old server, which reports
+// HANDOFF_DONE once its threads have stopped, or -1 on failure.
+int take_over_from_running_server(void) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, CTL_SOCK_PATH, sizeof(addr.sun_path) - 1);
+    int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (conn == -1 || connect(conn, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("[HANDOFF] No running server to take over from");
+        if (conn != -1) close(conn);
+        return -1;
+    }
+
+    int fds[2];
+    HandoffHeader hdr;
+    if (recv_fds(conn, fds, 2, &hdr) == -1) {
+        fprintf(stderr, "[HANDOFF] Did not receive fds from running server.\n");
+        close(conn);
+        return -1;
+    }
+
+    // Mapping a segment laid out by a different build would read past its end
+    // (SIGBUS) or misread live state, so only an identical layout is taken over.
+    struct stat st;
+    bool compatible = hdr.layout_version == SHM_LAYOUT_VERSION &&
+                      hdr.shm_size == sizeof(SharedGameData) &&
+                      fstat(fds[1], &st) == 0 && st.st_size >= (off_t)sizeof(SharedGameData);
+    if (!compatible) {
+        fprintf(stderr, "[HANDOFF] Running server uses state layout v%u (%lu bytes), this binary v%d (%zu bytes). "
+                        "Refusing takeover; restart the server normally instead.\n",
+                hdr.layout_version, hdr.shm_size, SHM_LAYOUT_VERSION, sizeof(SharedGameData));
+        char refuse = HANDOFF_REFUSE;
+        send(conn, &refuse, 1, MSG_NOSIGNAL);
+        close(fds[0]);
+        close(fds[1]);
+        close(conn);
+        return -1;
+    }
+
+    g_server_fd = fds[0];
+    g_shm_fd = fds[1];
+    g_shm_ptr = attach_shared_memory(g_shm_fd, sizeof(SharedGameData));
+    char reply = g_shm_ptr ? HANDOFF_ACCEPT : HANDOFF_REFUSE;
+    send(conn, &reply, 1, MSG_NOSIGNAL);
+    if (!g_shm_ptr) {
+        perror("[HANDOFF] Shared Memory Error");
+        close(conn);
+        return -1;
+    }
+    return conn;
 }
 
 void cleanup_handler(int sig) {
@@ -716,54 +2100,136 @@ void cleanup_handler(int sig) {
     if (g_shm_ptr) {
         g_shm_ptr->server_running = false;
         sem_post(&g_shm_ptr->log_sem);
+        sem_post(&g_shm_ptr->cmd_sem);
+        wake_view_waiters(g_shm_ptr);     // The session worker sees the stop and exits
         cleanup_sync_primitives(g_shm_ptr);
     }
     shm_unlink(SHM_NAME);
     if(g_server_fd != -1) close(g_server_fd);
+    if(g_ctl_fd != -1) { close(g_ctl_fd); unlink(CTL_SOCK_PATH); }
     exit(0);
 }
 
+// SIGINT: main leaves its loop, waits for the scheduler and logger to stop, saves the
+// scores and cleans up. Before there is any shared state, it cleans up at once.
+void stop_handler(int sig) {
+    if (!g_shm_ptr) cleanup_handler(sig);
+    g_shm_ptr->server_running = false;
+    sem_post(&g_shm_ptr->log_sem);
+    sem_post(&g_shm_ptr->cmd_sem);
+}
+
 void sigchld_handler(int s) { while(waitpid(-1, NULL, WNOHANG) > 0); }
 
-int main() {
-    signal(SIGCHLD, sigchld_handler);
-    signal(SIGINT, cleanup_handler);
+pid_t start_session_worker(int handoff_conn) {
+    g_worker_gen = atomic_fetch_add(&g_shm_ptr->worker_generation, 1) + 1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGUSR1, worker_drain_handler);
+        if (g_ctl_fd != -1) close(g_ctl_fd);
+        if (handoff_conn != -1) close(handoff_conn);
+        session_worker(g_server_fd, g_shm_ptr);
+        exit(0);
+    }
+    if (pid == -1) perror("[SERVER] Failed to start session worker");
+    return pid;
+}
 
-    int shm_fd = create_shared_memory(SHM_NAME, sizeof(SharedGameData));
-    g_shm_ptr = attach_shared_memory(shm_fd, sizeof(SharedGameData));
-    if (!g_shm_ptr) { perror("Shared Memory Error"); exit(1); }
+#ifndef SERVER_NO_MAIN
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "-m") == 0) {
+        print_memory_report(argc > 2 ? atol(argv[2]) : MEMORY_REPORT_CONNS);
+        return 0;
+    }
+    bool takeover = (argc > 1 && strcmp(argv[1], "-r") == 0);
 
-    initialize_sync_primitives(g_shm_ptr);
-    init_game_board(g_shm_ptr);
-    load_scores(g_shm_ptr);
+    signal(SIGCHLD, sigchld_handler);
+    signal(SIGINT, stop_handler);
 
     pthread_t t_sched, t_log;
-    pthread_create(&t_sched, NULL, scheduler_thread, g_shm_ptr);
-    pthread_create(&t_log, NULL, logger_thread, g_shm_ptr);
-
-    int new_socket;
-    struct sockaddr_in address;
-    int opt=1, addrlen=sizeof(address);
-    
-    g_server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    setsockopt(g_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    address.sin_family=AF_INET; address.sin_addr.s_addr=INADDR_ANY; address.sin_port=htons(PORT);
-    bind(g_server_fd, (struct sockaddr*)&address, sizeof(address));
-    listen(g_server_fd, MAX_PLAYERS);
+    bool threads_started = false;
+    int handoff_conn = -1;
+    init_game_board();
+
+    if (takeover) {
+        handoff_conn = take_over_from_running_server();
+        if (handoff_conn == -1) exit(1);
+        printf("[SERVER] Took over listening socket and live state.\n");
+    } else {
+        g_shm_fd = create_shared_memory(SHM_NAME, sizeof(SharedGameData));
+        g_shm_ptr = attach_shared_memory(g_shm_fd, sizeof(SharedGameData));
+        if (!g_shm_ptr) { perror("Shared Memory Error"); exit(1); }
+
+        initialize_sync_primitives(g_shm_ptr);
+        load_scores(&g_scores);
+        log_event(g_shm_ptr, "SERVER_START: Fresh state, no players.");
+
+        pthread_create(&t_sched, NULL, scheduler_thread, g_shm_ptr);
+        pthread_create(&t_log, NULL, logger_thread, g_shm_ptr);
+        threads_started = true;
+
+        struct sockaddr_in address;
+        int opt=1;
+        g_server_fd = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(g_server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        address.sin_family=AF_INET; address.sin_addr.s_addr=INADDR_ANY; address.sin_port=htons(PORT);
+        bind(g_server_fd, (struct sockaddr*)&address, sizeof(address));
+        listen(g_server_fd, SOMAXCONN);
+    }
+    // Both servers' workers may poll the shared listening socket during a handoff.
+    fcntl(g_server_fd, F_SETFL, fcntl(g_server_fd, F_GETFL) | O_NONBLOCK);
+    g_worker_pid = start_session_worker(handoff_conn);
+
+    g_ctl_fd = create_control_socket();
+    if (g_ctl_fd == -1) perror("[HANDOFF] Control socket unavailable, hot restart disabled");
 
     printf("[SERVER] Listening on port %d. Waiting for 3 players...\n", PORT);
 
     while (g_shm_ptr->server_running) {
-        if ((new_socket = accept(g_server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen)) >= 0) {
-            if (fork() == 0) { 
-                close(g_server_fd); 
-                handle_client(new_socket, g_shm_ptr); 
-                exit(0); 
+        // The worker serves every client: if it died, start another.
+        if (g_worker_pid <= 0 || (kill(g_worker_pid, 0) == -1 && errno == ESRCH)) {
+            fprintf(stderr, "[SERVER] Session worker exited. Restarting it.\n");
+            // Its clients are disconnected: free their seats before anyone new arrives.
+            Command evict = { .type = CMD_EVICT, .worker = g_worker_gen };
+            while (!command_push(g_shm_ptr, &evict, NULL) && g_shm_ptr->server_running) usleep(1000);
+            g_worker_pid = start_session_worker(handoff_conn);
+        }
+        struct pollfd pfds[2] = {
+            { .fd = g_ctl_fd, .events = POLLIN },
+            { .fd = handoff_conn, .events = POLLIN },   // Negative fds are ignored by poll
+        };
+        if (poll(pfds, 2, 1000) <= 0) continue;
+
+        if (pfds[1].revents) {
+            // Old server has stopped its threads (or died): ours take over.
+            char done;
+            recv(handoff_conn, &done, 1, 0);
+            close(handoff_conn);
+            handoff_conn = -1;
+            load_scores(&g_scores);          // As the old server saved them on its way out
+            pthread_create(&t_sched, NULL, scheduler_thread, g_shm_ptr);
+            pthread_create(&t_log, NULL, logger_thread, g_shm_ptr);
+            threads_started = true;
+            // Only now: with the queue full, log_event would wait for our logger.
+            log_event(g_shm_ptr, "SERVER_HANDOFF: New binary attached to live state.");
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            int conn = accept(g_ctl_fd, NULL, NULL);
+            if (conn >= 0) {
+                if (handoff_conn != -1) close(conn); // Still finishing our own takeover
+                else handoff_to_successor(conn, t_sched, t_log);
             }
-            else close(new_socket);
         }
-        usleep(100000); 
+    }
+    if (threads_started) {
+        pthread_join(t_sched, NULL);
+        pthread_join(t_log, NULL);
+        flush_scores(&g_scores);
     }
     cleanup_handler(0);
     return 0;
-}
\ No newline at end of file
+}
+#endif
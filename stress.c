@@ -0,0 +1,439 @@
+// Stress test of the room state machine, and its throughput against the mutex
+// design it replaced (make stress && ./stress). server.c is compiled in without its
+// main and the binary is built with -fsanitize=thread: any data race between the
+// scheduler, the logger and the session threads fails the run.
+//
+//   ./stress [-n moves] [-c churn] [-r rooms]
+//
+// Stress: the real scheduler_thread and logger_thread run -r rooms' worth of players
+// with shortened timers. Each session thread joins wherever the scheduler places it,
+// reads its room's published views, queues ROLLs and sleeps on the view epoch in
+// between, like the session worker does.
+// The first player of every five leaves and rejoins (usually another room) every -c
+// of its moves, the second lets every 16th turn time out and then sends the late
+// roll anyway, everyone follows the scheduler when it merges their room into a
+// fuller one, and every thread checks each view it reads: positions on the board,
+// turns only moving forward within a game, a winner standing on 100. Any violation
+// makes the exit status 1.
+//
+// Throughput: one room of players with no churn or skips, once through the command
+// queue and once through the old design, where every session took turn_mutex to
+// claim its turn and draw, player_mutex to move and turn_mutex again to hand the
+// turn on, logging in between. Both log every move to game.log in a temporary
+// directory. Under TSAN both designs run several times slower; build with
+// "make stress STRESS_FLAGS=-O2" for uninstrumented numbers.
+
+#define SERVER_NO_MAIN
+#include "server.c"
+
+#define LATE_ROLL_EVERY 16
+
+typedef struct {
+    int index;
+    long churn;
+    bool skips;                 // Lets some turns time out
+} PlayerArgs;
+
+typedef struct {
+    int room;
+    int player;
+    unsigned int token;
+} Seat;
+
+static SharedGameData *shared;
+static pthread_barrier_t joins_queued;
+static atomic_long moves_done;
+static atomic_long rejoins;
+static atomic_long room_moves;
+static atomic_long late_rolls;
+static atomic_long violations;
+static long target_moves;
+static FILE *report_out;        // stdout itself is silenced: the scheduler prints on every game
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void violation(int player, const char *what, int value) {
+    fprintf(report_out, "[STRESS] P%d saw %s (%d)\n", player + 1, what, value);
+    atomic_fetch_add(&violations, 1);
+}
+
+// Stops the scheduler (if running) and the logger once everything queued is written.
+static void stop_threads(pthread_t *t_sched, pthread_t t_log) {
+    if (t_sched) {
+        unsigned int head = atomic_load(&shared->cmds.head);
+        while (head && !command_applied(shared, head - 1)) sched_yield();
+    }
+    while (1) {
+        pthread_mutex_lock(&shared->log_mutex);
+        bool drained = shared->log_head == shared->log_tail;
+        pthread_mutex_unlock(&shared->log_mutex);
+        if (drained) break;
+        usleep(1000);
+    }
+    shared->server_running = false;
+    g_threads_running = false;
+    sem_post(&shared->cmd_sem);
+    sem_post(&shared->log_sem);
+    if (t_sched) pthread_join(*t_sched, NULL);
+    pthread_join(t_log, NULL);
+}
+
+static void push_command(const Command *cmd, unsigned int *position) {
+    while (!command_push(shared, cmd, position)) sched_yield();
+}
+
+static unsigned int view_epoch(void) {
+    return atomic_load_explicit(&shared->view_epoch, memory_order_acquire);
+}
+
+// Queues a JOIN for the room given, or with -1 for the room the scheduler sends new
+// players to, as session_join does.
+static bool push_join(Seat *seat, const char *name, int room, unsigned int *position) {
+    Command cmd = { .type = CMD_JOIN, .room = room != -1 ? room : atomic_load(&shared->open_room), .token = seat->token };
+    if (cmd.room < 0) return false;
+    snprintf(cmd.name, sizeof(cmd.name), "%s", name);
+    push_command(&cmd, position);
+    seat->room = cmd.room;
+    return true;
+}
+
+// Waits for the JOIN at position to be applied and finds the seat it got; a JOIN
+// that lost its room to others is sent again to the room open now.
+static bool await_seat(Seat *seat, const char *name, unsigned int position) {
+    while (1) {
+        while (1) {
+            unsigned int epoch = view_epoch();
+            if (command_applied(shared, position)) break;
+            wait_for_views(shared, epoch, 100);
+        }
+        GameView v;
+        read_view(&shared->rooms[seat->room], &v);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            if (v.state[i] != PLAYER_DISCONNECTED && v.token[i] == seat->token) {
+                seat->player = i;
+                return true;
+            }
+        }
+        if (!push_join(seat, name, -1, &position)) return false;
+    }
+}
+
+// Leaves the seat and takes one in room (-1: wherever the scheduler places it).
+static bool change_room(Seat *seat, const char *name, int room) {
+    unsigned int position;
+    Command leave = { .type = CMD_LEAVE, .room = seat->room, .player = seat->player, .token = seat->token };
+    push_command(&leave, NULL);
+    return push_join(seat, name, room, &position) && await_seat(seat, name, position);
+}
+
+static void check_view(int me, const GameView *v, int *game, int *turn) {
+    for (int i = 0; i < MAX_PLAYERS; i++)
+        if (v->position[i] < 0 || v->position[i] > BOARD_SIZE) violation(me, "position off the board", v->position[i]);
+    if (v->game_state == GAME_FINISHED &&
+        (v->winner_index < 0 || v->position[v->winner_index] != BOARD_SIZE))
+        violation(me, "winner not on 100", v->winner_index);
+    if (v->game_state == GAME_PLAYING || v->game_state == GAME_FINISHED) {
+        if (v->game_id == *game && v->turn_number < *turn) violation(me, "turn going backwards", v->turn_number);
+        if (v->game_id < *game) violation(me, "game going backwards", v->game_id);
+        *game = v->game_id;
+        *turn = v->turn_number;
+    }
+}
+
+// --- Command queue design ---
+static void *queue_player(void *arg) {
+    PlayerArgs *a = arg;
+    char name[MAX_NAME_LEN];
+    snprintf(name, sizeof(name), "stress%d", a->index + 1);
+    // Everyone's first JOIN is queued before the scheduler starts, so the rooms fill
+    // before their first game.
+    Seat seat = { .token = atomic_fetch_add(&shared->next_token, 1) };
+    unsigned int position;
+    bool queued = push_join(&seat, name, -1, &position);
+    pthread_barrier_wait(&joins_queued);
+    if (!queued || !await_seat(&seat, name, position)) { violation(a->index, "no seat", -1); return NULL; }
+    int me = seat.player;
+    Room *room = &shared->rooms[seat.room];
+
+    int rolled_game = -1, rolled_turn = -1, seen_game = -1, seen_turn = 0;
+    int skipped_game = -1, skipped_turn = -1;
+    long my_moves = 0, my_turns = 0;
+    while (atomic_load(&moves_done) < target_moves) {
+        GameView v;
+        unsigned int epoch = view_epoch();
+        read_view(room, &v);
+        if (v.merge_into >= 0) {
+            // The scheduler is emptying this room into a fuller one: follow, as the worker does.
+            if (!change_room(&seat, name, v.merge_into)) { violation(a->index, "no seat on room move", -1); return NULL; }
+            me = seat.player;
+            room = &shared->rooms[seat.room];
+            seen_game = -1;
+            seen_turn = 0;
+            rolled_turn = -1;
+            atomic_fetch_add(&room_moves, 1);
+            continue;
+        }
+        check_view(a->index, &v, &seen_game, &seen_turn);
+        if (v.game_id == skipped_game && v.last_move[me].turn == skipped_turn)
+            violation(a->index, "late roll applied to turn", skipped_turn);
+
+        if (v.game_id == rolled_game && v.last_move[me].turn == rolled_turn && rolled_turn > 0) {
+            atomic_fetch_add(&moves_done, 1);
+            rolled_turn = -1;
+            if (a->churn && ++my_moves % a->churn == 0) {
+                if (!change_room(&seat, name, -1)) { violation(a->index, "no seat on rejoin", -1); return NULL; }
+                me = seat.player;
+                room = &shared->rooms[seat.room];
+                seen_game = -1;
+                seen_turn = 0;
+                atomic_fetch_add(&rejoins, 1);
+            }
+            continue;
+        }
+
+        bool my_turn = v.game_state == GAME_PLAYING && v.current_player == me && v.token[me] == seat.token;
+        if (!my_turn || (v.game_id == rolled_game && v.turn_number == rolled_turn)) {
+            wait_for_views(shared, epoch, 100);
+            continue;
+        }
+        if (a->skips && ++my_turns % LATE_ROLL_EVERY == 0) {
+            // Sit the turn out, then answer it once the scheduler has moved on.
+            int game = v.game_id, turn = v.turn_number;
+            do {
+                wait_for_views(shared, epoch, 100);
+                epoch = view_epoch();
+                read_view(room, &v);
+            } while (v.game_id == game && v.turn_number == turn && v.game_state == GAME_PLAYING &&
+                     atomic_load(&moves_done) < target_moves);
+            Command late = { .type = CMD_ROLL, .room = seat.room, .player = me, .turn = turn, .token = seat.token };
+            push_command(&late, NULL);
+            skipped_game = game;
+            skipped_turn = turn;
+            atomic_fetch_add(&late_rolls, 1);
+            continue;
+        }
+        Command roll = { .type = CMD_ROLL, .room = seat.room, .player = me, .turn = v.turn_number, .token = seat.token };
+        push_command(&roll, NULL);
+        rolled_game = v.game_id;
+        rolled_turn = v.turn_number;
+    }
+    return NULL;
+}
+
+static double run_queue(int players, long churn, bool skips) {
+    initialize_sync_primitives(shared);
+    atomic_store(&moves_done, 0);
+    g_threads_running = true;
+    pthread_t t_sched, t_log;
+    pthread_t *threads = malloc(sizeof(pthread_t) * players);
+    PlayerArgs *args = malloc(sizeof(PlayerArgs) * players);
+    pthread_barrier_init(&joins_queued, NULL, players + 1);
+    pthread_create(&t_log, NULL, logger_thread, shared);
+
+    for (int i = 0; i < players; i++) {
+        args[i] = (PlayerArgs){ .index = i, .churn = (i % MAX_PLAYERS == 0) ? churn : 0,
+                                .skips = skips && i % MAX_PLAYERS == 1 };
+        pthread_create(&threads[i], NULL, queue_player, &args[i]);
+    }
+    pthread_barrier_wait(&joins_queued);
+    double start = now_seconds();
+    pthread_create(&t_sched, NULL, scheduler_thread, shared);
+    for (int i = 0; i < players; i++) pthread_join(threads[i], NULL);
+    double elapsed = now_seconds() - start;
+
+    stop_threads(&t_sched, t_log);
+    pthread_barrier_destroy(&joins_queued);
+    cleanup_sync_primitives(shared);
+    free(threads);
+    free(args);
+    return atomic_load(&moves_done) / elapsed;
+}
+
+// --- Mutex design ---
+// The turn sequence of the forked client sessions and the scheduler before the command queue,
+// with the 5s start and reset pauses taken out.
+typedef struct {
+    pthread_mutex_t game_mutex;
+    pthread_mutex_t turn_mutex;
+    pthread_mutex_t player_mutex;
+    Room room;
+} MutexGame;
+
+static MutexGame *mgame;
+
+static void mutex_new_game(MutexGame *g, unsigned int seed) {
+    pthread_mutex_lock(&g->turn_mutex);
+    g->room.current_player = 0;
+    g->room.turn_number = 0;
+    pthread_mutex_unlock(&g->turn_mutex);
+
+    pthread_mutex_lock(&g->player_mutex);
+    for (int i = 0; i < MAX_PLAYERS; i++) g->room.players[i].position = 0;
+    pthread_mutex_unlock(&g->player_mutex);
+    log_event(shared, "GAME_RESET: Board cleared for new game.");
+
+    pthread_mutex_lock(&g->turn_mutex);
+    seed_game(&g->room, seed);
+    g->room.current_player = get_next_active_player(&g->room, MAX_PLAYERS - 1);
+    g->room.turn_number = 1;
+    pthread_mutex_unlock(&g->turn_mutex);
+    log_event(shared, "GAME_START: New game began.");
+
+    pthread_mutex_lock(&g->game_mutex);
+    g->room.game_state = GAME_PLAYING;
+    g->room.game_id++;
+    pthread_mutex_unlock(&g->game_mutex);
+}
+
+static void *mutex_player(void *arg) {
+    int me = ((PlayerArgs *)arg)->index;
+    MutexGame *g = mgame;
+    char log_buf[LOG_MSG_LEN];
+    while (atomic_load(&moves_done) < target_moves) {
+        pthread_mutex_lock(&g->game_mutex);
+        GameState state = g->room.game_state;
+        pthread_mutex_unlock(&g->game_mutex);
+        if (state != GAME_PLAYING) { sched_yield(); continue; }
+
+        pthread_mutex_lock(&g->turn_mutex);
+        if (g->room.current_player != me) {
+            pthread_mutex_unlock(&g->turn_mutex);
+            sched_yield();
+            continue;
+        }
+        TurnResult r = draw_turn(&g->room);
+        pthread_mutex_unlock(&g->turn_mutex);
+
+        pthread_mutex_lock(&g->player_mutex);
+        g->room.players[me].position = r.to;
+        pthread_mutex_unlock(&g->player_mutex);
+
+        snprintf(log_buf, sizeof(log_buf), "MOVE: T%d P%d stress%d rolled %d from %d to %d",
+                 r.turn, me + 1, me + 1, r.roll, r.from, r.to);
+        log_event(shared, log_buf);
+        atomic_fetch_add(&moves_done, 1);
+
+        if (r.to == BOARD_SIZE) {
+            pthread_mutex_lock(&g->game_mutex);
+            g->room.game_state = GAME_FINISHED;
+            g->room.winner_index = me;
+            int game = g->room.game_id;
+            pthread_mutex_unlock(&g->game_mutex);
+            snprintf(log_buf, sizeof(log_buf), "GAME_OVER: We have a winner. P%d", me + 1);
+            log_event(shared, log_buf);
+            mutex_new_game(g, (unsigned int)game + 1);
+        } else {
+            pthread_mutex_lock(&g->turn_mutex);
+            pass_turn(&g->room, me);
+            pthread_mutex_unlock(&g->turn_mutex);
+        }
+    }
+    return NULL;
+}
+
+static double run_mutex(int players) {
+    initialize_sync_primitives(shared);
+    atomic_store(&moves_done, 0);
+    g_threads_running = true;
+    mgame = calloc(1, sizeof(MutexGame));
+    pthread_mutex_init(&mgame->game_mutex, NULL);
+    pthread_mutex_init(&mgame->turn_mutex, NULL);
+    pthread_mutex_init(&mgame->player_mutex, NULL);
+    room_init(&mgame->room);
+    for (int i = 0; i < players; i++) {
+        char name[MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "stress%d", i + 1);
+        add_player(&mgame->room, name, 0);
+    }
+    start_game(&mgame->room, 1);
+
+    pthread_t t_log, threads[MAX_PLAYERS];
+    PlayerArgs args[MAX_PLAYERS];
+    pthread_create(&t_log, NULL, logger_thread, shared);
+    double start = now_seconds();
+    for (int i = 0; i < players; i++) {
+        args[i] = (PlayerArgs){ .index = i };
+        pthread_create(&threads[i], NULL, mutex_player, &args[i]);
+    }
+    for (int i = 0; i < players; i++) pthread_join(threads[i], NULL);
+    double elapsed = now_seconds() - start;
+
+    stop_threads(NULL, t_log);
+    cleanup_sync_primitives(shared);
+    free(mgame);
+    return atomic_load(&moves_done) / elapsed;
+}
+
+static long count_lines(const char *prefix) {
+    long n = 0;
+    char line[LOG_MSG_LEN + 64];
+    FILE *f = fopen("game.log", "r");
+    if (!f) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        const char *msg = strstr(line, "] ");
+        int room;
+        if (msg && strncmp(log_message_room(msg + 2, &room), prefix, strlen(prefix)) == 0) n++;
+    }
+    fclose(f);
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    long moves = 20000;
+    long churn = 25;
+    int rooms = 4;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:r:")) != -1) {
+        switch (opt) {
+            case 'n': moves = atol(optarg); break;
+            case 'c': churn = atol(optarg); break;
+            case 'r': rooms = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n moves] [-c churn] [-r rooms]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (moves < 1 || churn < 0 || rooms < 1 || rooms > 64) {
+        fprintf(stderr, "moves must be positive, rooms 1-64\n");
+        return 1;
+    }
+    target_moves = moves;
+
+    char dir[] = "/tmp/snl_stress_XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) == -1) { perror("[STRESS] Temp dir"); return 1; }
+    report_out = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report_out || !freopen("/dev/null", "w", stdout)) return 1;
+
+    init_game_board();
+    shared = malloc(sizeof(SharedGameData));
+    if (!shared) return 1;
+
+    // Timers short enough that a skipped turn costs milliseconds, and no pauses
+    // between games.
+    g_timings = (SchedulerTimings){ .turn_limit = 20, .start_delay = 0, .reset_delay = 0 };
+    run_queue(rooms * MAX_PLAYERS, churn, true);
+    fprintf(report_out, "[STRESS] state machine: %d players in %d rooms, %ld moves, %ld games, %ld timeouts, "
+                        "%ld rejoins, %ld room moves, %ld late rolls, %ld violations\n",
+            rooms * MAX_PLAYERS, shared->rooms_used, count_lines("MOVE:"), count_lines("GAME_OVER:"),
+            count_lines("TIMEOUT:"), atomic_load(&rejoins), atomic_load(&room_moves), atomic_load(&late_rolls), atomic_load(&violations));
+    unlink("game.log");
+
+    // No skips here, so a turn only times out if a thread is starved that long.
+    g_timings.turn_limit = TURN_TIME_LIMIT * 1000;
+    double queued = run_queue(MAX_PLAYERS, 0, false);
+    unlink("game.log");
+    double locked = run_mutex(MAX_PLAYERS);
+    unlink("game.log");
+    fprintf(report_out, "[STRESS] throughput, %d players, %ld moves: command queue %.0f moves/s, "
+                        "mutexes %.0f moves/s (%.2fx)\n",
+            MAX_PLAYERS, moves, queued, locked, locked > 0 ? queued / locked : 0.0);
+
+    unlink("scores.txt");
+    if (chdir("/") == 0) rmdir(dir);
+    free(shared);
+    return atomic_load(&violations) ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+// Elimination tournament, simulated offline: it never talks to a running server.
+// server.c is compiled in without its main; every match is a full game on a Room of
+// the tournament's own, played by bots with the server's rules (play_turn). Worker
+// threads each own one room and pull matches from a queue.
+//
+//   ./tournament [-n players] [-w workers] [-s seed] [-o standings.txt]
+//
+// Round 1 is seeded from scores.txt: registered players ordered by wins, then bots
+// ("bot00001"...) up to -n entrants, dealt serpentine-style into groups of up to
+// MAX_PLAYERS. The bracket is fixed up front: the winner of match i of a round plays
+// in match i / MAX_PLAYERS of the next, and the groups are placed so the strongest
+// ones sit in different subtrees and top seeds meet late. A match is queued the
+// moment its own feeder matches are done, without waiting for the rest of the round.
+// Every match is seeded from (-s seed, round, slot), so a seed reproduces the whole
+// tournament whatever order the workers finish in. Wins of registered players are
+// written back to scores.txt in one batched update at the end; bots are not recorded.
+// Scores are read into the same ScoreTable the server keeps, not into shared memory.
+
+#define SERVER_NO_MAIN
+#include "server.c"
+
+#define MAX_ROUNDS 32
+#define MATCH_TURN_LIMIT 100000     // Safety net; highest position wins if reached
+
+typedef struct {
+    int round;
+    int slot;                       // Index within the round
+    int count;                      // Players seated so far
+    int feeders;                    // Matches whose winners play here (0 in round 1)
+    int players[MAX_PLAYERS];       // players[i] is the winner of feeder i
+    unsigned int seed;
+} Match;
+
+typedef struct {
+    char name[MAX_NAME_LEN];
+    bool registered;                // Came from scores.txt
+    int match_wins;
+    int eliminated_round;           // 0 while still in, rounds + 1 for the champion
+} Entrant;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    Match *rounds_of[MAX_ROUNDS];   // The bracket: every match of every round
+    int matches_in[MAX_ROUNDS];
+    int rounds;
+
+    Match **queue;                  // Matches whose players are all known
+    int q_head, q_tail;
+
+    int champion;
+    long matches_played;
+    unsigned int base_seed;
+} Bracket;
+
+static Entrant *entrants;
+static int num_entrants;
+static Bracket bracket;
+
+// --- Bracket ---
+static void build_bracket(int first_round_matches) {
+    int n = first_round_matches;
+    for (int r = 0; r < MAX_ROUNDS; r++) {
+        bracket.matches_in[r] = n;
+        bracket.rounds_of[r] = calloc(n, sizeof(Match));
+        for (int i = 0; i < n; i++) {
+            Match *m = &bracket.rounds_of[r][i];
+            m->round = r;
+            m->slot = i;
+            m->seed = bracket.base_seed + (unsigned int)r * 2654435761u + (unsigned int)i * 40503u;
+            if (r > 0) {
+                int prev = bracket.matches_in[r - 1];
+                m->feeders = (i + 1) * MAX_PLAYERS <= prev ? MAX_PLAYERS : prev - i * MAX_PLAYERS;
+            }
+        }
+        bracket.rounds = r + 1;
+        if (n == 1) break;
+        n = (n + MAX_PLAYERS - 1) / MAX_PLAYERS;
+    }
+    int total = 0;
+    for (int r = 0; r < bracket.rounds; r++) total += bracket.matches_in[r];
+    bracket.queue = calloc(total, sizeof(Match*));
+}
+
+// Under bracket.lock.
+static void enqueue_match(Match *m) {
+    bracket.queue[bracket.q_tail++] = m;
+    pthread_cond_signal(&bracket.cond);
+}
+
+static void declare_champion(int player, int round) {
+    bracket.champion = player;
+    entrants[player].eliminated_round = round + 2;
+    pthread_cond_broadcast(&bracket.cond);
+}
+
+static void match_finished(const Match *m, int winner) {
+    pthread_mutex_lock(&bracket.lock);
+    int r = m->round;
+    bracket.matches_played++;
+    for (int i = 0; i < m->count; i++) {
+        if (m->players[i] != winner) entrants[m->players[i]].eliminated_round = r + 1;
+    }
+    if (m->count > 1) entrants[winner].match_wins++;
+
+    if (r == bracket.rounds - 1) {
+        declare_champion(winner, r);
+    } else {
+        Match *next = &bracket.rounds_of[r + 1][m->slot / MAX_PLAYERS];
+        next->players[m->slot % MAX_PLAYERS] = winner;
+        if (++next->count == next->feeders) enqueue_match(next);
+    }
+    pthread_mutex_unlock(&bracket.lock);
+}
+
+// --- Matches ---
+// Same turn sequence as a live room with every player rolling immediately.
+static int play_match(Room *room, const Match *m) {
+    if (m->count == 1) return m->players[0];
+
+    room_init(room);
+    for (int i = 0; i < m->count; i++) add_player(room, entrants[m->players[i]].name, 0);
+    start_game(room, m->seed);
+
+    for (int t = 0; t < MATCH_TURN_LIMIT; t++) {
+        TurnResult r = play_turn(room);
+        if (r.to == BOARD_SIZE) return m->players[r.player];
+    }
+    int best = 0;
+    for (int i = 1; i < m->count; i++)
+        if (room->players[i].position > room->players[best].position) best = i;
+    return m->players[best];
+}
+
+static void *match_worker(void *arg) {
+    Room *room = malloc(sizeof(Room));
+    if (!room) return NULL;
+    while (1) {
+        pthread_mutex_lock(&bracket.lock);
+        while (bracket.q_head == bracket.q_tail && bracket.champion == -1)
+            pthread_cond_wait(&bracket.cond, &bracket.lock);
+        if (bracket.q_head == bracket.q_tail) {
+            pthread_mutex_unlock(&bracket.lock);
+            break;
+        }
+        Match *m = bracket.queue[bracket.q_head++];
+        pthread_mutex_unlock(&bracket.lock);
+
+        int winner = play_match(room, m);
+        match_finished(m, winner);
+    }
+    free(room);
+    return NULL;
+}
+
+// --- Seeding and Results ---
+static int compare_wins(const void *a, const void *b) {
+    return ((const ScoreEntry*)b)->wins - ((const ScoreEntry*)a)->wins;
+}
+
+static void seed_entrants(const ScoreTable *scores, int total) {
+    entrants = calloc(total, sizeof(Entrant));
+    int registered = scores->count;
+    ScoreEntry *ranked = malloc(sizeof(ScoreEntry) * (registered ? registered : 1));
+    memcpy(ranked, scores->entries, sizeof(ScoreEntry) * registered);
+    qsort(ranked, registered, sizeof(ScoreEntry), compare_wins);
+
+    for (int i = 0; i < total; i++) {
+        if (i < registered) {
+            memcpy(entrants[i].name, ranked[i].name, MAX_NAME_LEN);
+            entrants[i].name[MAX_NAME_LEN - 1] = '\0';
+            entrants[i].registered = true;
+        } else {
+            snprintf(entrants[i].name, MAX_NAME_LEN, "bot%05d", i - registered + 1);
+        }
+    }
+    num_entrants = total;
+    free(ranked);
+}
+
+// Puts the n groups in ranked (strongest first) on the round 1 slots lo..lo+n-1, which
+// the bracket joins into subtrees of span slots. They are dealt serpentine-style over
+// the child subtrees, then placed within each child the same way.
+static void place_groups(int *ranked, int n, int lo, int span, int *slot_of) {
+    if (n == 1) { slot_of[ranked[0]] = lo; return; }
+    int child = span / MAX_PLAYERS;
+    int children = (n + child - 1) / child;
+    int *dealt = malloc(sizeof(int) * n);
+    int counts[MAX_PLAYERS] = {0};
+    for (int placed = 0, pass = 0; placed < n; pass++) {
+        for (int k = 0; k < children && placed < n; k++) {
+            int c = (pass % 2 == 0) ? k : children - 1 - k;
+            int cap = (c + 1) * child <= n ? child : n - c * child;
+            if (counts[c] < cap) dealt[c * child + counts[c]++] = ranked[placed++];
+        }
+    }
+    for (int c = 0; c < children; c++)
+        place_groups(dealt + c * child, counts[c], lo + c * child, child, slot_of);
+    free(dealt);
+}
+
+// Round 1: seed i goes down one column of groups and back up the next, so group g
+// holds seed g; the groups are then placed in the bracket by that strength.
+static void seed_first_round(void) {
+    int groups = (num_entrants + MAX_PLAYERS - 1) / MAX_PLAYERS;
+    build_bracket(groups);
+
+    int *ranked = malloc(sizeof(int) * groups);
+    int *slot_of = malloc(sizeof(int) * groups);
+    int span = 1;
+    while (span < groups) span *= MAX_PLAYERS;
+    for (int g = 0; g < groups; g++) ranked[g] = g;
+    place_groups(ranked, groups, 0, span, slot_of);
+
+    for (int i = 0; i < num_entrants; i++) {
+        int row = i / groups, col = i % groups;
+        Match *m = &bracket.rounds_of[0][slot_of[(row % 2 == 0) ? col : groups - 1 - col]];
+        m->players[m->count++] = i;
+    }
+    pthread_mutex_lock(&bracket.lock);
+    for (int g = 0; g < groups; g++) enqueue_match(&bracket.rounds_of[0][g]);
+    pthread_mutex_unlock(&bracket.lock);
+    free(ranked);
+    free(slot_of);
+}
+
+static int compare_standing(const void *a, const void *b) {
+    const Entrant *x = &entrants[*(const int*)a], *y = &entrants[*(const int*)b];
+    if (x->eliminated_round != y->eliminated_round) return y->eliminated_round - x->eliminated_round;
+    if (x->match_wins != y->match_wins) return y->match_wins - x->match_wins;
+    return *(const int*)a - *(const int*)b;     // Then by seed
+}
+
+static void write_standings(const char *path) {
+    int *order = malloc(sizeof(int) * num_entrants);
+    for (int i = 0; i < num_entrants; i++) order[i] = i;
+    qsort(order, num_entrants, sizeof(int), compare_standing);
+
+    FILE *f = fopen(path, "w");
+    if (!f) { perror("[TOURNAMENT] Failed to write standings"); free(order); return; }
+    fprintf(f, "%-6s %-*s %-6s %s\n", "Rank", MAX_NAME_LEN, "Player", "Wins", "Reached");
+    for (int i = 0; i < num_entrants; i++) {
+        Entrant *e = &entrants[order[i]];
+        if (order[i] == bracket.champion) fprintf(f, "%-6d %-*s %-6d Champion\n", i + 1, MAX_NAME_LEN, e->name, e->match_wins);
+        else fprintf(f, "%-6d %-*s %-6d Round %d\n", i + 1, MAX_NAME_LEN, e->name, e->match_wins, e->eliminated_round);
+    }
+    fclose(f);
+    free(order);
+}
+
+// All wins of registered players go to the score table in one pass and one save_scores().
+static void record_scores(ScoreTable *scores) {
+    for (int i = 0; i < num_entrants; i++) {
+        if (!entrants[i].registered || !entrants[i].match_wins) continue;
+        ScoreEntry *e = score_find(scores, entrants[i].name, false);
+        if (e) e->wins += entrants[i].match_wins;
+    }
+    save_scores(scores->entries, scores->count);
+}
+
+int main(int argc, char *argv[]) {
+    int total = 100;
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int seed = (unsigned int)time(NULL);
+    const char *standings_path = "tournament.txt";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:s:o:")) != -1) {
+        switch (opt) {
+            case 'n': total = atoi(optarg); break;
+            case 'w': workers = atoi(optarg); break;
+            case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'o': standings_path = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n players] [-w workers] [-s seed] [-o standings.txt]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (total < 1 || workers < 1) { fprintf(stderr, "players and workers must be positive\n"); return 1; }
+
+    init_game_board();
+    load_scores(&g_scores);
+    if (total < g_scores.count) total = g_scores.count;
+    seed_entrants(&g_scores, total);
+
+    pthread_mutex_init(&bracket.lock, NULL);
+    pthread_cond_init(&bracket.cond, NULL);
+    bracket.champion = -1;
+    bracket.base_seed = seed;
+
+    printf("[TOURNAMENT] %d entrants (%d registered), %d workers, seed %u\n",
+           num_entrants, g_scores.count, workers, seed);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    seed_first_round();
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    for (int i = 0; i < workers; i++) pthread_create(&threads[i], NULL, match_worker, NULL);
+    for (int i = 0; i < workers; i++) pthread_join(threads[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    printf("[TOURNAMENT] Champion: %s after %d rounds, %ld matches in %.3fs\n",
+           entrants[bracket.champion].name, bracket.rounds, bracket.matches_played, elapsed);
+    write_standings(standings_path);
+    record_scores(&g_scores);
+    printf("[TOURNAMENT] Standings written to %s\n", standings_path);
+
+    free(threads);
+    return 0;
+}